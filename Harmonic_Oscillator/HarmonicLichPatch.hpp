@@ -24,11 +24,15 @@ DESCRIPTION:
     Harmonic Lich is a CV and MIDI controlled harmonic oscillator.
     Eight sine wave oscillators are tuned to the harmonic series, and the 
     level of each can be controlled by parameters AA to AH (or MIDI).
+    Define HARMONICS as 16 or 32 for more harmonics, on parameters AA to BH
+    or AA to DH. Silent harmonics, and those above Nyquist, cost nothing.
     With parameters A and B you control the root note played and detune it.
     The left audio input gives 1v/oct input CV control of the frequency.
     Parameter C will change the harmonic center, and D controls how high 
     and low frequencies are attenuated. 
     Buttons A and B mute the odd and even harmonics respectively.
+    Define USE_PITCH_TRACKING to follow the 1v/oct input at every sample,
+    rather than once per block, for audio rate pitch modulation.
     MIDI Note messages control the root note.
     Output parameters F and G reflect the total signal level within the 
     oscillator at any time.
@@ -38,29 +42,55 @@ DESCRIPTION:
 #include "Envelope.h"
 #include "VoltsPerOctave.h"
 #include "SmoothValue.h"
-#include "SineOscillator.h"
+#include "ParameterCache.hpp"
+#include "HarmonicOscillatorBank.hpp"
 
 #define USE_FM
-#define TONES 8
-// Up to 16 harmonics supported
+// #define USE_PITCH_TRACKING
+#ifndef HARMONICS
+#define HARMONICS 8
+#endif
+// Up to 32 harmonics supported
 static const char* names[] = { "H1", "H2", "H3", "H4", "H5", "H6", "H7", "H8",
-			       "H9", "H10", "H11", "H12", "H13", "H14", "H15", "H16" };
+			       "H9", "H10", "H11", "H12", "H13", "H14", "H15", "H16",
+			       "H17", "H18", "H19", "H20", "H21", "H22", "H23", "H24",
+			       "H25", "H26", "H27", "H28", "H29", "H30", "H31", "H32" };
 
+#ifdef USE_PITCH_TRACKING
+/* 2^x with a 4th order polynomial for the fraction, relative error < 2.8e-6 */
+static inline float exp2_approx(float x){
+  x = max(-126.0f, min(126.0f, x));
+  int e = (int)(x + 127.0f) - 127; // floor
+  float f = x - e;
+  union { int32_t i; float f; } scale;
+  scale.i = (e + 127) << 23;
+  return scale.f*(1.0000026f + f*(0.69300383f + f*(0.24144277f + f*(0.052011490f + f*0.013534137f))));
+}
+#endif
 
-class HarmonicLichPatch : public Patch {
+template<int TONES>
+class HarmonicLich : public Patch {
 private:
-  Oscillator* osc[TONES];
-  float levels[TONES];
+  MemoryRegions regions;
+  HarmonicOscillatorBank<TONES>* bank;
+  float targets[TONES];
   bool mutes[TONES];
-  FloatArray mix;
+  // slots 0 to TONES-1 hold the harmonic level parameters
+  enum { CACHE_CENTRE = TONES, CACHE_PEAK, CACHE_COUNT };
+  ParameterCache<CACHE_COUNT> cache;
+  float targetgain = 1.0f;
   FloatArray ramp;
+#ifdef USE_PITCH_TRACKING
+  FloatArray pitch;
+#endif
   VoltsPerOctave hz;
   float gainadjust = 0.0f;
   StiffFloat semitone;
   int centernote = 0;
   const float NYQUIST;
 public:
-  HarmonicLichPatch() : hz(true), NYQUIST(getSampleRate()/2) {
+  HarmonicLich() : regions(sizeof(HarmonicOscillatorBank<TONES>) + getBlockSize()*2*sizeof(float), 0),
+		   cache(1/2048.0f), hz(true), NYQUIST(getSampleRate()/2) {
     registerParameter(PARAMETER_A, "Semitone");
     registerParameter(PARAMETER_B, "Fine Tune");
     registerParameter(PARAMETER_C, "Centre");
@@ -75,23 +105,28 @@ public:
 #endif
     registerParameter(PARAMETER_F, "Overflow>");
     registerParameter(PARAMETER_G, "Intensity>");
+    bank = HarmonicOscillatorBank<TONES>::create(getSampleRate());
     for(int i=0; i<TONES; i++){
-      osc[i] = SineOscillator::create(getSampleRate());
       registerParameter(PatchParameterId(PARAMETER_AA+i), names[i]);
       setParameterValue(PatchParameterId(PARAMETER_AA+i), 0.50);
-      levels[i] = 1;
+      bank->setLevel(i, 1);
+      targets[i] = 1;
       mutes[i] = false;
     }
-    mix = FloatArray::create(getBlockSize());
-    ramp = FloatArray::create(getBlockSize());
+    ramp = MemoryTiers::get().createFloatArray(getBlockSize(), HOT_MEMORY);
+#ifdef USE_PITCH_TRACKING
+    pitch = MemoryTiers::get().createFloatArray(getBlockSize(), HOT_MEMORY);
+#endif
+    MemoryTiers::get().report();
     semitone.delta = 0.5;
   }
 
-  ~HarmonicLichPatch(){
-    for(int i=0; i<TONES; i++)
-      SineOscillator::destroy((SineOscillator*)osc[i]);
-    FloatArray::destroy(mix);
-    FloatArray::destroy(ramp);
+  ~HarmonicLich(){
+    HarmonicOscillatorBank<TONES>::destroy(bank);
+    MemoryTiers::get().destroy(ramp);
+#ifdef USE_PITCH_TRACKING
+    MemoryTiers::get().destroy(pitch);
+#endif
   }
 
   void buttonChanged(PatchButtonId bid, uint16_t value, uint16_t samples){
@@ -99,10 +134,12 @@ public:
     case BUTTON_A:
       for(int i=0; i<TONES; i+= 2)
 	mutes[i] = value;
+      cache.invalidate();
       break;
     case BUTTON_B:
       for(int i=1; i<TONES; i+= 2)
 	mutes[i] = value;
+      cache.invalidate();
       break;
     }
   }
@@ -118,12 +155,11 @@ public:
     }
   }
 
-  void processAudio(AudioBuffer& buf){
-    semitone = getParameterValue(PARAMETER_A)*56-56;
-    float freq = round(semitone+centernote)/12 + getParameterValue(PARAMETER_B)/6;
-    float centre = getParameterValue(PARAMETER_C)*(TONES-1);
+  /* recompute the target level of each harmonic, and the gain adjustment */
+  void updateLevels(){
+    float centre = cache[CACHE_CENTRE]*(TONES-1);
     float a, r;
-    float d = getParameterValue(PARAMETER_D);
+    float d = cache[CACHE_PEAK];
     if(d < 0.20){       /* //.\\ */
       a = 1-d*5;
       r = 1;
@@ -140,42 +176,71 @@ public:
       a = 1;
       r = (d-0.80)*5;      
     }                   /* //.\\ */
+    float total = 0;
+    for(int i=0; i<TONES; i++){
+      float distance = abs(centre - i);
+      float duck = i < centre ? a*distance : r*distance;
+      targets[i] = mutes[i] ? 0 : max(0, min(1, cache[i]*(1-duck)));
+      total += targets[i];
+    }
+    targetgain = total > 1 ? 1/total : 1;
+  }
+
+  void processAudio(AudioBuffer& buf){
+    semitone = getParameterValue(PARAMETER_A)*56-56;
+    float freq = round(semitone+centernote)/12 + getParameterValue(PARAMETER_B)/6;
+    // not short-circuited: every slot must be updated
+    bool changed = cache.update(CACHE_CENTRE, getParameterValue(PARAMETER_C)) |
+      cache.update(CACHE_PEAK, getParameterValue(PARAMETER_D));
+    for(int i=0; i<TONES; i++)
+      changed |= cache.update(i, getParameterValue(PatchParameterId(PARAMETER_AA+i)));
+    if(changed)
+      updateLevels();
     float fm = getParameterValue(PARAMETER_E)*0.2;
     FloatArray left = buf.getSamples(LEFT_CHANNEL);
     FloatArray right = buf.getSamples(RIGHT_CHANNEL);
     hz.setTune(freq);
+#ifdef USE_PITCH_TRACKING
+    // the frequency at each sample is the 0v frequency times 2^volts
+    float fundamental = hz.getFrequency(0);
+    float scale = hz.sampleToVolts(1) - hz.sampleToVolts(0);
+    float lowest = 1, highest = 1;
+    for(size_t i=0; i<pitch.getSize(); i++){
+      pitch[i] = exp2_approx(left[i]*scale);
+      lowest = min(lowest, pitch[i]);
+      highest = max(highest, pitch[i]);
+    }
+    float* pitchdata = pitch.getData();
+#else
     float fundamental = hz.getFrequency(left[0]);
+    float lowest = 1, highest = 1;
+    float* pitchdata = NULL;
+#endif
     right.multiply(fm);
-    float newgainadjust = 0;
-    left.clear();
     for(int i=0; i<TONES; i++){
-      float newlevel = getParameterValue(PatchParameterId(PARAMETER_AA+i));
-      float distance = abs(centre - i);
-      float duck = i < centre ? a*distance : r*distance;
-      newlevel = mutes[i] ? 0 : max(0, min(1, newlevel*(1-duck)));
-      ramp.ramp(levels[i], newlevel);
-      levels[i] = newlevel;
-      newgainadjust += newlevel;
       freq = fundamental*(i+1);
-      if(freq > 10 && freq < NYQUIST){
-	osc[i]->setFrequency(freq);
+      // mute harmonics that are out of range anywhere in the block
+      if(freq*lowest > 10 && freq*highest < NYQUIST){
+	bank->setFrequency(i, freq);
+	bank->setLevel(i, targets[i]);
+      }else{
+	bank->mute(i);
+      }
+    }
 #ifdef USE_FM
-	osc[i]->getSamples(mix, right);
+    bank->getSamples(left.getData(), right.getData(), pitchdata, left.getSize());
 #else
-	osc[i]->getSamples(mix);
+    bank->getSamples(left.getData(), NULL, pitchdata, left.getSize());
 #endif
-	mix.multiply(ramp);
-	left.add(mix);
-      }
-    }
-    newgainadjust = newgainadjust > 1 ? 1/newgainadjust : 1;
-    ramp.ramp(gainadjust, newgainadjust);
+    ramp.ramp(gainadjust, targetgain);
     left.multiply(ramp);
     left.multiply(0.5);
-    gainadjust = newgainadjust;
+    gainadjust = targetgain;
     setParameterValue(PARAMETER_F, gainadjust);
     setParameterValue(PARAMETER_G, 1-gainadjust);
     right.copyFrom(left);
   }
 
 };
+
+typedef HarmonicLich<HARMONICS> HarmonicLichPatch;
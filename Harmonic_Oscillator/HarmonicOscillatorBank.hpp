@@ -0,0 +1,173 @@
+#ifndef __HarmonicOscillatorBank_hpp__
+#define __HarmonicOscillatorBank_hpp__
+
+#include "FloatArray.h"
+#include "MemoryTier.hpp"
+
+/**
+ * A bank of SIZE sine oscillators, summed into a single output with a
+ * separate level for each. The state of all partials is kept in arrays,
+ * one per field, and every output sample is computed in one pass over
+ * them, so that the inner loop has no calls and no dependency between
+ * partials: compilers unroll it, and vectorise it where the target has
+ * float SIMD.
+ *
+ * Phases are normalised to cycles, so that wrapping is a subtraction,
+ * and the sine is a 7th order polynomial with a maximum error of 7.4e-7.
+ *
+ * Partials that are silent for a whole block, ie with a current and a
+ * target level of zero, are culled: the cost of a block is proportional
+ * to the number of partials that sound in it.
+ */
+template<int SIZE>
+class HarmonicOscillatorBank {
+private:
+  static const int LANES = 4;
+  float mul;
+  float phases[SIZE];
+  float increments[SIZE];
+  float levels[SIZE];
+  float targets[SIZE];
+  int active[SIZE];
+  int count;
+
+  /* sin(2*pi*phase) for phase in (-1, 1) */
+  static float sine(float phase){
+    float x = 2*(phase - (int)(phase*2)); // (-1, 1], half cycles
+    float m = 0.5f - fabsf(fabsf(x) - 0.5f); // fold to [0, 0.5]
+    float m2 = m*m;
+    float y = m*(3.14158201f + m2*(-5.16714287f + m2*(2.54189944f + m2*-0.55463725f)));
+    return copysignf(y, x);
+  }
+public:
+  HarmonicOscillatorBank(float sr) : mul(1/sr), count(0) {
+    for(int k=0; k<SIZE; k++){
+      phases[k] = 0;
+      increments[k] = 0;
+      levels[k] = 0;
+      targets[k] = 0;
+    }
+  }
+
+  void setFrequency(int index, float freq){
+    increments[index] = freq*mul;
+  }
+
+  float getFrequency(int index){
+    return increments[index]/mul;
+  }
+
+  /**
+   * set the level of partial @param index, which is reached with a
+   * linear ramp over the next block
+   */
+  void setLevel(int index, float level){
+    targets[index] = level;
+  }
+
+  float getLevel(int index){
+    return targets[index];
+  }
+
+  /**
+   * silence partial @param index immediately, without a ramp
+   */
+  void mute(int index){
+    levels[index] = targets[index] = 0;
+  }
+
+  /**
+   * get the number of partials that were computed in the last block
+   */
+  int getActiveCount(){
+    return count;
+  }
+
+  void reset(){
+    for(int k=0; k<SIZE; k++)
+      phases[k] = 0;
+  }
+
+  void getSamples(FloatArray output){
+    getSamples(output.getData(), NULL, output.getSize());
+  }
+
+  void getSamples(FloatArray output, FloatArray fm){
+    getSamples(output.getData(), fm.getData(), NULL, output.getSize());
+  }
+
+  void getSamples(float* output, float* fm, size_t len){
+    getSamples(output, fm, NULL, len);
+  }
+
+  /**
+   * write the sum of all partials to @param output. If not NULL, @param fm
+   * is added to the phase increment of every partial, in radians per sample,
+   * and the phase increment of every partial is multiplied by @param pitch,
+   * for pitch modulation at audio rate.
+   */
+  void getSamples(float* output, float* fm, float* pitch, size_t len){
+    float scale = 0.5/M_PI;
+    float drift = 0; // total FM phase offset over the block
+    if(fm != NULL){
+      for(size_t i=0; i<len; i++)
+	drift += fm[i];
+      drift *= scale;
+    }
+    float span = len; // total pitch over the block
+    if(pitch != NULL){
+      span = 0;
+      for(size_t i=0; i<len; i++)
+	span += pitch[i];
+    }
+    // gather the partials that sound in this block into contiguous
+    // arrays, padded with silent partials to a whole number of lanes.
+    // Culled partials only have their phase moved on to the end of the block.
+    float phs[SIZE+LANES], incs[SIZE+LANES], lvls[SIZE+LANES], steps[SIZE+LANES];
+    count = 0;
+    for(int k=0; k<SIZE; k++){
+      if(levels[k] != 0 || targets[k] != 0){
+	active[count] = k;
+	phs[count] = phases[k];
+	incs[count] = increments[k];
+	lvls[count] = levels[k];
+	steps[count] = (targets[k] - levels[k])/len;
+	count++;
+      }else{
+	float phase = phases[k] + increments[k]*span + drift;
+	phases[k] = phase - (int)phase;
+      }
+      levels[k] = targets[k];
+    }
+    int padded = (count + LANES - 1) & ~(LANES - 1);
+    for(int j=count; j<padded; j++)
+      phs[j] = incs[j] = lvls[j] = steps[j] = 0;
+    for(size_t i=0; i<len; i++){
+      float offset = fm == NULL ? 0 : fm[i]*scale;
+      float ratio = pitch == NULL ? 1 : pitch[i];
+      float x = i;
+      float sum[LANES] = {};
+      for(int j=0; j<padded; j+=LANES){
+	for(int l=0; l<LANES; l++){
+	  sum[l] += sine(phs[j+l])*(lvls[j+l] + steps[j+l]*x);
+	  float phase = phs[j+l] + incs[j+l]*ratio + offset;
+	  phs[j+l] = phase - (int)phase;
+	}
+      }
+      // horizontal sum of the lanes
+      output[i] = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+    }
+    for(int j=0; j<count; j++)
+      phases[active[j]] = phs[j];
+  }
+
+  static HarmonicOscillatorBank<SIZE>* create(float sr){
+    return MemoryTiers::get().create<HarmonicOscillatorBank<SIZE> >(HOT_MEMORY, sr);
+  }
+
+  static void destroy(HarmonicOscillatorBank<SIZE>* bank){
+    MemoryTiers::get().destroy(bank);
+  }
+};
+
+#endif // __HarmonicOscillatorBank_hpp__
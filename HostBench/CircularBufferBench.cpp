@@ -0,0 +1,157 @@
+/**
+
+DESCRIPTION:
+    Micro-benchmark of CircularBuffer against the previous implementation,
+    which indexed with a modulo and branched on every single sample write.
+
+    For each buffer size two workloads are timed:
+    - sample: one read at a fixed delay and one write per sample, as in
+      the ping pong delay loop
+    - block: one block write and one block read per block, as in the
+      reverb nodes and pre-delay
+
+    A second table times the same workloads, and a crossfaded block read,
+    with each of the sample storage types, and gives the largest error of
+    a sine at -20dB read back from the buffer.
+*/
+
+#include <chrono>
+#include <stdio.h>
+
+#include "FloatArray.h"
+#include "CircularBuffer.hpp"
+#include "CrossFadeBuffer.hpp"
+
+/* CircularBuffer as it was before masked indexing and span reads */
+class LegacyCircularBuffer {
+private:
+  FloatArray buffer;
+  unsigned int writeIndex;
+public:
+  LegacyCircularBuffer(FloatArray buf) : buffer(buf), writeIndex(0) {}
+  void write(float* source, size_t len){
+    float* ptr = &buffer[writeIndex];
+    float* end = &buffer[buffer.getSize()];
+    int cnt = len;
+    writeIndex = (writeIndex + cnt) & (buffer.getSize()-1);
+    while(ptr < end && cnt--)
+      *ptr++ = *source++;
+    ptr = &buffer[0];
+    while(cnt-- > 0)
+      *ptr++ = *source++;
+  }
+  inline void write(float value){
+    if(++writeIndex == buffer.getSize())
+      writeIndex = 0;
+    buffer[writeIndex] = value;
+  }
+  inline float read(int index){
+    return buffer[(writeIndex-index) % buffer.getSize()];
+  }
+  void read(int readIndex, float* destination, size_t len){
+    float* ptr = &buffer[(writeIndex + ~(readIndex+len)) & (buffer.getSize()-1)];
+    float* end = &buffer[buffer.getSize()];
+    int cnt = len;
+    while(ptr < end && cnt--)
+      *destination++ = *ptr++;
+    ptr = &buffer[0];
+    while(cnt-- > 0)
+      *destination++ = *ptr++;
+  }
+};
+
+static const size_t BLOCKSIZE = 64;
+static const size_t SAMPLES = 1<<24;
+
+template<class Buffer>
+double sampleLoop(Buffer& buffer, int delay, float* block, float& checksum){
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(size_t n=0; n<SAMPLES; n+=BLOCKSIZE){
+    for(size_t i=0; i<BLOCKSIZE; i++){
+      float y = buffer.read(delay);
+      buffer.write(block[i] + y*0.5f);
+      checksum += y;
+    }
+  }
+  std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(stop - start).count()/SAMPLES;
+}
+
+template<class Buffer>
+double blockLoop(Buffer& buffer, int delay, float* block, float* out, float& checksum){
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(size_t n=0; n<SAMPLES; n+=BLOCKSIZE){
+    buffer.write(block, BLOCKSIZE);
+    buffer.read(delay, out, BLOCKSIZE);
+    checksum += out[n & (BLOCKSIZE-1)];
+  }
+  std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(stop - start).count()/SAMPLES;
+}
+
+template<class Buffer>
+double fadeLoop(Buffer& buffer, int delay, float* block, float* out, float& checksum){
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(size_t n=0; n<SAMPLES; n+=BLOCKSIZE){
+    buffer.write(block, BLOCKSIZE);
+    buffer.fade(delay + (n & BLOCKSIZE), out, BLOCKSIZE);
+    checksum += out[n & (BLOCKSIZE-1)];
+  }
+  std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(stop - start).count()/SAMPLES;
+}
+
+/* largest error of a sine read back after a full buffer of delay */
+template<class Buffer>
+float roundTrip(Buffer& buffer){
+  float error = 0;
+  size_t size = buffer.getSize();
+  for(size_t i=0; i<size*2; i++){
+    float x = 0.1f*sinf(i*0.01f);
+    if(i >= size)
+      error = max(error, fabsf(buffer.read(size-1) - 0.1f*sinf((i-size)*0.01f)));
+    buffer.write(x);
+  }
+  return error;
+}
+
+template<class Storage>
+void storageBench(const char* name, float* block, float* out, float& checksum){
+  int size = 65536;
+  int delay = size/2 + 17;
+  CrossFadeSampleBuffer<Storage>* buffer = CrossFadeSampleBuffer<Storage>::create(size, BLOCKSIZE);
+  double sample = sampleLoop(*buffer, delay, block, checksum);
+  double blocks = blockLoop(*buffer, delay, block, out, checksum);
+  double fade = fadeLoop(*buffer, delay, block, out, checksum);
+  float error = roundTrip(*buffer);
+  printf("  %8s %12.3f %12.3f %12.3f %12.2e\n", name, sample, blocks, fade, error);
+  CrossFadeSampleBuffer<Storage>::destroy(buffer);
+}
+
+int main(){
+  float block[BLOCKSIZE];
+  float out[BLOCKSIZE];
+  for(size_t i=0; i<BLOCKSIZE; i++)
+    block[i] = i/(float)BLOCKSIZE - 0.5f;
+  float checksum = 0;
+  printf("# CircularBuffer: ns/sample, block size %d\n", (int)BLOCKSIZE);
+  printf("# %8s %12s %12s %12s %12s\n", "size", "sample old", "sample new", "block old", "block new");
+  for(int size=8192; size<=262144; size*=2){
+    int delay = size/2 + 17;
+    FloatArray samples = FloatArray::create(size);
+    LegacyCircularBuffer legacy(samples);
+    CircularBuffer current(samples);
+    double oldSample = sampleLoop(legacy, delay, block, checksum);
+    double newSample = sampleLoop(current, delay, block, checksum);
+    double oldBlock = blockLoop(legacy, delay, block, out, checksum);
+    double newBlock = blockLoop(current, delay, block, out, checksum);
+    printf("  %8d %12.3f %12.3f %12.3f %12.3f\n", size, oldSample, newSample, oldBlock, newBlock);
+    FloatArray::destroy(samples);
+  }
+  printf("# storage: ns/sample, size 65536\n");
+  printf("# %8s %12s %12s %12s %12s\n", "storage", "sample", "block", "fade", "max error");
+  storageBench<FloatStorage>("float", block, out, checksum);
+  storageBench<ShortStorage>("short", block, out, checksum);
+  storageBench<BlockFloatStorage>("block", block, out, checksum);
+  return checksum == 12345.0f;
+}
@@ -0,0 +1,162 @@
+/**
+
+DESCRIPTION:
+    Equivalence and speed of StereoDcFilter against a pair of DcFilters,
+    as the patches ran them before. The stereo filter is checked sample
+    for sample, exactly, in each of its modes: in a block, one sample at
+    a time, and fused into the write to a pair of delay lines, with float
+    storage and with block floating point, which has no write window.
+
+    The times are for in-place filtering of a stereo block, and for
+    filtering followed by the write to two delay lines, as at the top of
+    the reverb, against the fused write. Returns 1 if any mode differs.
+*/
+
+#include <chrono>
+#include <stdio.h>
+
+#include "Patch.h"
+#include "DcFilter.hpp"
+#include "CircularBuffer.hpp"
+
+static const size_t BLOCKSIZE = 64;
+static const size_t CHECKSIZE = 48; // does not divide the delay lines, so some writes wrap
+static const size_t SAMPLES = 1<<24;
+static const size_t DELAY = 1<<12;
+
+/* fill a stereo block with an offset, a tone and noise */
+static void generate(AudioBuffer& buffer, uint32_t& seed, size_t offset){
+  FloatArray left = buffer.getSamples(LEFT_CHANNEL);
+  FloatArray right = buffer.getSamples(RIGHT_CHANNEL);
+  for(int i=0; i<buffer.getSize(); i++){
+    seed = seed*1664525 + 1013904223;
+    float noise = (int32_t)seed * (1.0f/2147483648.0f);
+    left[i] = 0.2f + 0.5f*sinf((offset+i)*0.031f) + 0.1f*noise;
+    right[i] = -0.1f + 0.5f*sinf((offset+i)*0.047f) - 0.1f*noise;
+  }
+}
+
+/* count the samples of @param a and @param b that differ */
+static size_t compare(FloatArray a, FloatArray b){
+  size_t count = 0;
+  for(size_t i=0; i<a.getSize(); i++)
+    count += a[i] != b[i];
+  return count;
+}
+
+enum CheckMode {
+  CHECK_BLOCK,
+  CHECK_SAMPLE,
+  CHECK_FUSED,        // and read the delay lines back
+  CHECK_FUSED_OUTPUT  // for lossy storage, which cannot be read back exactly
+};
+
+/**
+ * run the reference DcFilters and the StereoDcFilter in @param mode side
+ * by side, writing to @param delayLeft and @param delayRight when fused,
+ * and return the number of samples that differ
+ */
+template<class DelayLine>
+size_t check(CheckMode mode, DelayLine* delayLeft, DelayLine* delayRight){
+  AudioBuffer* input = AudioBuffer::create(2, CHECKSIZE);
+  AudioBuffer* output = AudioBuffer::create(2, CHECKSIZE);
+  FloatArray expected = FloatArray::create(CHECKSIZE);
+  FloatArray delayed = FloatArray::create(CHECKSIZE);
+  DcFilter left, right;
+  StereoDcFilter stereo;
+  uint32_t seed = 22222;
+  size_t errors = 0;
+  for(size_t n=0; n<3*DELAY; n+=CHECKSIZE){
+    generate(*input, seed, n);
+    FloatArray inputs[2] = { input->getSamples(LEFT_CHANNEL), input->getSamples(RIGHT_CHANNEL) };
+    FloatArray outputs[2] = { output->getSamples(LEFT_CHANNEL), output->getSamples(RIGHT_CHANNEL) };
+    outputs[0].copyFrom(inputs[0]);
+    outputs[1].copyFrom(inputs[1]);
+    if(mode == CHECK_BLOCK){
+      stereo.process(*output);
+    }else if(mode == CHECK_SAMPLE){
+      for(size_t i=0; i<CHECKSIZE; i++)
+	stereo.process(outputs[0][i], outputs[1][i]);
+    }else{
+      stereo.process(*output, delayLeft, delayRight);
+    }
+    DcFilter* filters[2] = { &left, &right };
+    DelayLine* delays[2] = { delayLeft, delayRight };
+    for(int ch=0; ch<2; ch++){
+      filters[ch]->process(inputs[ch], expected);
+      errors += compare(expected, outputs[ch]);
+      if(mode == CHECK_FUSED){
+	delays[ch]->read(-1, delayed.getData(), CHECKSIZE);
+	errors += compare(expected, delayed);
+      }
+    }
+  }
+  AudioBuffer::destroy(input);
+  AudioBuffer::destroy(output);
+  FloatArray::destroy(expected);
+  FloatArray::destroy(delayed);
+  return errors;
+}
+
+/* time @param process on a stereo block, in ns/sample */
+template<class Function>
+double run(AudioBuffer& buffer, float& checksum, Function process){
+  uint32_t seed = 1;
+  generate(buffer, seed, 0);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(size_t n=0; n<SAMPLES; n+=BLOCKSIZE){
+    process();
+    checksum += buffer.getSamples(LEFT_CHANNEL)[n & (BLOCKSIZE-1)];
+  }
+  std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(stop - start).count()/SAMPLES;
+}
+
+int main(){
+  CircularBuffer* floatLeft = CircularBuffer::create(DELAY);
+  CircularBuffer* floatRight = CircularBuffer::create(DELAY);
+  CircularBlockFloatBuffer* compactLeft = CircularBlockFloatBuffer::create(DELAY);
+  CircularBlockFloatBuffer* compactRight = CircularBlockFloatBuffer::create(DELAY);
+  size_t errors[4];
+  errors[0] = check(CHECK_BLOCK, floatLeft, floatRight);
+  errors[1] = check(CHECK_SAMPLE, floatLeft, floatRight);
+  errors[2] = check(CHECK_FUSED, floatLeft, floatRight);
+  errors[3] = check(CHECK_FUSED_OUTPUT, compactLeft, compactRight);
+  printf("# StereoDcFilter: samples differing from two DcFilters\n");
+  printf("  %-16s %8d\n", "block", (int)errors[0]);
+  printf("  %-16s %8d\n", "sample", (int)errors[1]);
+  printf("  %-16s %8d\n", "fused float", (int)errors[2]);
+  printf("  %-16s %8d\n", "fused compact", (int)errors[3]);
+
+  AudioBuffer* buffer = AudioBuffer::create(2, BLOCKSIZE);
+  FloatArray left = buffer->getSamples(LEFT_CHANNEL);
+  FloatArray right = buffer->getSamples(RIGHT_CHANNEL);
+  DcFilter dcLeft, dcRight;
+  StereoDcFilter stereo;
+  float checksum = 0;
+  printf("# StereoDcFilter: ns per stereo sample, block size %d\n", (int)BLOCKSIZE);
+  printf("  %-16s %8.3f\n", "two DcFilters", run(*buffer, checksum, [&](){
+	dcLeft.process(left);
+	dcRight.process(right);
+      }));
+  printf("  %-16s %8.3f\n", "stereo", run(*buffer, checksum, [&](){
+	stereo.process(*buffer);
+      }));
+  printf("  %-16s %8.3f\n", "two + write", run(*buffer, checksum, [&](){
+	dcLeft.process(left);
+	dcRight.process(right);
+	floatLeft->write(left);
+	floatRight->write(right);
+      }));
+  printf("  %-16s %8.3f\n", "fused write", run(*buffer, checksum, [&](){
+	stereo.process(*buffer, floatLeft, floatRight);
+      }));
+
+  AudioBuffer::destroy(buffer);
+  CircularBuffer::destroy(floatLeft);
+  CircularBuffer::destroy(floatRight);
+  CircularBlockFloatBuffer::destroy(compactLeft);
+  CircularBlockFloatBuffer::destroy(compactRight);
+  bool equal = errors[0] == 0 && errors[1] == 0 && errors[2] == 0 && errors[3] == 0;
+  return equal && checksum != 12345.0f ? 0 : 1;
+}
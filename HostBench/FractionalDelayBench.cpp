@@ -0,0 +1,136 @@
+/**
+
+DESCRIPTION:
+    Accuracy and speed of the FractionalDelay readers. A sine at 0.01 fs
+    is written to a CircularBuffer a block at a time and read back at
+    fractional delays, with linear, Hermite and allpass interpolation:
+    one sample at a time and a block at a time at a fixed delay, and a
+    block with the delay moving across it. Each is compared with the sine
+    evaluated at the exact delayed time.
+
+    Returns 1 if the worst error of an interpolation exceeds its limit:
+    linear interpolation is the least accurate of the three, Hermite the
+    most. The allpass has no limit for a moving delay, as its state
+    makes a transient whenever the integer part of the delay changes.
+*/
+
+#include <chrono>
+#include <stdio.h>
+
+#include "Patch.h"
+#include "FractionalDelay.hpp"
+
+static const size_t BLOCKSIZE = 64;
+static const size_t BLOCKS = 1<<12;
+static const size_t SETTLE = 16; // blocks before the errors count, for the allpass state
+static const size_t SAMPLES = 1<<24;
+static const size_t DELAY = 1<<12;
+static const double FREQUENCY = 0.01; // cycles per sample
+
+enum ReadMode {
+  READ_SAMPLE,
+  READ_FIXED,
+  READ_MOVING
+};
+
+/* the delay for block @param n when it moves: fractional, and changing slowly between blocks */
+static float delayAt(size_t n){
+  return 20.0f + 8.0f*sinf(n*0.01f) + 0.37f;
+}
+
+/**
+ * write the sine to a buffer a block at a time, read it back in
+ * @param read mode with @param mode interpolation, and return the largest
+ * difference from the exact delayed sine
+ */
+template<InterpolationMode mode>
+float check(ReadMode read){
+  CircularBuffer* buffer = CircularBuffer::create(DELAY);
+  FloatArray input = FloatArray::create(BLOCKSIZE);
+  FloatArray output = FloatArray::create(BLOCKSIZE);
+  FractionalDelay<mode> tap;
+  float worst = 0;
+  for(size_t n=0; n<BLOCKS; n++){
+    size_t start = n*BLOCKSIZE;
+    for(size_t i=0; i<BLOCKSIZE; i++)
+      input[i] = sin(2*M_PI*FREQUENCY*(start+i));
+    buffer->write(input);
+    float from = read == READ_MOVING ? delayAt(n) : delayAt(0);
+    float to = read == READ_MOVING ? delayAt(n+1) : from;
+    if(read == READ_SAMPLE){
+      for(size_t i=0; i<BLOCKSIZE; i++)
+	output[i] = tap.read(buffer, from+BLOCKSIZE-1-i);
+    }else{
+      tap.read(buffer, from, to, output.getData(), BLOCKSIZE);
+    }
+    if(n < SETTLE)
+      continue;
+    float step = (to - from)/BLOCKSIZE;
+    for(size_t i=0; i<BLOCKSIZE; i++){
+      double time = (double)(start + i) - (from + i*step); // in double: start is past float precision
+      double expected = sin(2*M_PI*FREQUENCY*time);
+      worst = max(worst, (float)fabs(output[i] - expected));
+    }
+  }
+  CircularBuffer::destroy(buffer);
+  FloatArray::destroy(input);
+  FloatArray::destroy(output);
+  return worst;
+}
+
+/* time block reads of a buffer at @param from moving to @param to, in ns/sample */
+template<InterpolationMode mode>
+double run(CircularBuffer* buffer, FloatArray output, float from, float to, float& checksum){
+  FractionalDelay<mode> tap;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(size_t n=0; n<SAMPLES; n+=BLOCKSIZE){
+    buffer->moveWriteHead(BLOCKSIZE);
+    tap.read(buffer, from, to, output.getData(), BLOCKSIZE);
+    checksum += output[n & (BLOCKSIZE-1)];
+  }
+  std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(stop - start).count()/SAMPLES;
+}
+
+int main(){
+  const char* names[] = { "linear", "hermite", "allpass" };
+  const float limits[] = { 1e-3, 5e-5, 1e-4 };
+  float errors[3][3] = {
+    { check<LINEAR_INTERPOLATION>(READ_SAMPLE), check<LINEAR_INTERPOLATION>(READ_FIXED), check<LINEAR_INTERPOLATION>(READ_MOVING) },
+    { check<HERMITE_INTERPOLATION>(READ_SAMPLE), check<HERMITE_INTERPOLATION>(READ_FIXED), check<HERMITE_INTERPOLATION>(READ_MOVING) },
+    { check<ALLPASS_INTERPOLATION>(READ_SAMPLE), check<ALLPASS_INTERPOLATION>(READ_FIXED), check<ALLPASS_INTERPOLATION>(READ_MOVING) }
+  };
+  bool accurate = true;
+  printf("# FractionalDelay: max error against a sine at %.2f fs\n", FREQUENCY);
+  printf("  %-10s %10s %10s %10s %10s\n", "", "sample", "fixed", "moving", "limit");
+  for(int m=0; m<3; m++){
+    printf("  %-10s %10.2e %10.2e %10.2e %10.0e\n", names[m], errors[m][0], errors[m][1], errors[m][2], limits[m]);
+    for(int r=READ_SAMPLE; r<=READ_MOVING; r++)
+      if(m != ALLPASS_INTERPOLATION || r != READ_MOVING)
+	accurate = accurate && errors[m][r] <= limits[m];
+  }
+
+  CircularBuffer* buffer = CircularBuffer::create(DELAY);
+  FloatArray output = FloatArray::create(BLOCKSIZE);
+  uint32_t seed = 1;
+  for(size_t i=0; i<DELAY; i++){
+    seed = seed*1664525 + 1013904223;
+    buffer->write((int32_t)seed * (1.0f/2147483648.0f));
+  }
+  float checksum = 0;
+  printf("# FractionalDelay: ns per sample, block size %d\n", (int)BLOCKSIZE);
+  printf("  %-10s %10s %10s\n", "", "fixed", "moving");
+  printf("  %-10s %10.3f %10.3f\n", names[0],
+	 run<LINEAR_INTERPOLATION>(buffer, output, 100.37f, 100.37f, checksum),
+	 run<LINEAR_INTERPOLATION>(buffer, output, 100.37f, 102.11f, checksum));
+  printf("  %-10s %10.3f %10.3f\n", names[1],
+	 run<HERMITE_INTERPOLATION>(buffer, output, 100.37f, 100.37f, checksum),
+	 run<HERMITE_INTERPOLATION>(buffer, output, 100.37f, 102.11f, checksum));
+  printf("  %-10s %10.3f %10.3f\n", names[2],
+	 run<ALLPASS_INTERPOLATION>(buffer, output, 100.37f, 100.37f, checksum),
+	 run<ALLPASS_INTERPOLATION>(buffer, output, 100.37f, 102.11f, checksum));
+
+  CircularBuffer::destroy(buffer);
+  FloatArray::destroy(output);
+  return accurate && checksum != 12345.0f ? 0 : 1;
+}
@@ -0,0 +1,57 @@
+/**
+
+DESCRIPTION:
+    Micro-benchmark of HarmonicOscillatorBank: CPU time against the number
+    of partials that sound, for banks of 8, 16 and 32 partials. Silent
+    partials are culled, so the time per block should follow the active
+    count rather than the size of the bank.
+*/
+
+#include <chrono>
+#include <stdio.h>
+
+#include "FloatArray.h"
+#include "HarmonicOscillatorBank.hpp"
+
+static const size_t BLOCKSIZE = 64;
+static const size_t SAMPLES = 1<<22;
+static const float SAMPLERATE = 48000;
+
+template<int SIZE>
+void run(float* out, float* fm, float& checksum){
+  HarmonicOscillatorBank<SIZE>* bank = HarmonicOscillatorBank<SIZE>::create(SAMPLERATE);
+  for(int k=0; k<SIZE; k++)
+    bank->setFrequency(k, 55.0f*(k+1));
+  for(int active=0; active<=SIZE; active+=SIZE/4){
+    for(int k=0; k<SIZE; k++){
+      if(k < active)
+	bank->setLevel(k, 1.0f/active);
+      else
+	bank->mute(k);
+    }
+    bank->getSamples(out, fm, BLOCKSIZE); // ramp to the new levels
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(size_t n=0; n<SAMPLES; n+=BLOCKSIZE){
+      bank->getSamples(out, fm, BLOCKSIZE);
+      checksum += out[n & (BLOCKSIZE-1)];
+    }
+    std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(stop - start).count()/SAMPLES;
+    printf("  %6d %8d %12.3f %12.3f\n", SIZE, bank->getActiveCount(), ns, active ? ns/active : 0.0);
+  }
+  HarmonicOscillatorBank<SIZE>::destroy(bank);
+}
+
+int main(){
+  float out[BLOCKSIZE];
+  float fm[BLOCKSIZE];
+  for(size_t i=0; i<BLOCKSIZE; i++)
+    fm[i] = 0.01f*sinf(i*2*M_PI/BLOCKSIZE);
+  float checksum = 0;
+  printf("# HarmonicOscillatorBank: ns/sample with FM, block size %d\n", (int)BLOCKSIZE);
+  printf("# %6s %8s %12s %12s\n", "size", "active", "ns/sample", "ns/partial");
+  run<8>(out, fm, checksum);
+  run<16>(out, fm, checksum);
+  run<32>(out, fm, checksum);
+  return checksum == 12345.0f;
+}
@@ -0,0 +1,123 @@
+#ifndef __BiquadFilter_h__
+#define __BiquadFilter_h__
+
+/*
+ * Host stand-in for the OwlProgram BiquadFilter: a cascade of direct
+ * form I stages, as computed by arm_biquad_cascade_df1_f32 on the device.
+ * Cutoff frequencies are normalised to the Nyquist frequency.
+ */
+
+#include "Patch.h"
+
+class FilterStage {
+public:
+  static constexpr float BUTTERWORTH_Q = 0.70710678118655f;
+  static void setLowPass(float* coefficients, float fc, float q){
+    float omega = M_PI*fc;
+    float K = tanf(omega*0.5f);
+    float norm = 1 / (1 + K / q + K * K);
+    coefficients[0] = K * K * norm;
+    coefficients[1] = 2 * coefficients[0];
+    coefficients[2] = coefficients[0];
+    coefficients[3] = - 2 * (K * K - 1) * norm;
+    coefficients[4] = - (1 - K / q + K * K) * norm;
+  }
+  static void setHighPass(float* coefficients, float fc, float q){
+    float omega = M_PI*fc;
+    float K = tanf(omega*0.5f);
+    float norm = 1 / (1 + K / q + K * K);
+    coefficients[0] = 1 * norm;
+    coefficients[1] = -2 * coefficients[0];
+    coefficients[2] = coefficients[0];
+    coefficients[3] = - 2 * (K * K - 1) * norm;
+    coefficients[4] = - (1 - K / q + K * K) * norm;
+  }
+};
+
+class BiquadFilter {
+private:
+  int stages;
+  float* coefficients;
+  float* state;
+public:
+  BiquadFilter(int st) : stages(st) {
+    coefficients = new float[stages*5];
+    state = new float[stages*4];
+    memset(coefficients, 0, stages*5*sizeof(float));
+    coefficients[0] = 1;
+    memset(state, 0, stages*4*sizeof(float));
+  }
+  ~BiquadFilter(){
+    delete[] coefficients;
+    delete[] state;
+  }
+  void copyCoefficients(){
+    for(int i=1; i<stages; i++)
+      memcpy(coefficients+i*5, coefficients, 5*sizeof(float));
+  }
+  void setLowPass(float fc, float q){
+    FilterStage::setLowPass(coefficients, fc, q);
+    copyCoefficients();
+  }
+  void setHighPass(float fc, float q){
+    FilterStage::setHighPass(coefficients, fc, q);
+    copyCoefficients();
+  }
+  void process(float* input, float* output, size_t size){
+    for(int s=0; s<stages; s++){
+      float* c = coefficients+s*5;
+      float* st = state+s*4;
+      float x1 = st[0], x2 = st[1], y1 = st[2], y2 = st[3];
+      for(size_t i=0; i<size; i++){
+	float x = input[i];
+	float y = c[0]*x + c[1]*x1 + c[2]*x2 + c[3]*y1 + c[4]*y2;
+	x2 = x1;
+	x1 = x;
+	y2 = y1;
+	y1 = y;
+	output[i] = y;
+      }
+      st[0] = x1; st[1] = x2; st[2] = y1; st[3] = y2;
+      input = output;
+    }
+  }
+  void process(FloatArray in, FloatArray out){
+    process(in, out, in.getSize());
+  }
+  void process(FloatArray buf){
+    process(buf, buf, buf.getSize());
+  }
+  static BiquadFilter* create(int stages){
+    return new BiquadFilter(stages);
+  }
+  static void destroy(BiquadFilter* filter){
+    delete filter;
+  }
+};
+
+class StereoBiquadFilter {
+private:
+  BiquadFilter left, right;
+public:
+  StereoBiquadFilter(int stages) : left(stages), right(stages) {}
+  void setLowPass(float fc, float q){
+    left.setLowPass(fc, q);
+    right.setLowPass(fc, q);
+  }
+  void setHighPass(float fc, float q){
+    left.setHighPass(fc, q);
+    right.setHighPass(fc, q);
+  }
+  void process(AudioBuffer& buffer){
+    left.process(buffer.getSamples(LEFT_CHANNEL));
+    right.process(buffer.getSamples(RIGHT_CHANNEL));
+  }
+  static StereoBiquadFilter* create(int stages){
+    return new StereoBiquadFilter(stages);
+  }
+  static void destroy(StereoBiquadFilter* filter){
+    delete filter;
+  }
+};
+
+#endif // __BiquadFilter_h__
@@ -0,0 +1,22 @@
+#ifndef __Envelope_h__
+#define __Envelope_h__
+
+/*
+ * Host stand-in for the OwlProgram Envelope base class.
+ */
+
+#include "FloatArray.h"
+
+class Envelope {
+public:
+  virtual ~Envelope(){}
+  virtual void trigger(bool state, int triggerDelay){}
+  virtual void gate(bool state, int gateDelay){}
+  virtual float getNextSample() = 0;
+  virtual void getEnvelope(FloatArray output){
+    for(size_t i=0; i<output.getSize(); i++)
+      output[i] = getNextSample();
+  }
+};
+
+#endif // __Envelope_h__
@@ -0,0 +1,128 @@
+#ifndef __FloatArray_h__
+#define __FloatArray_h__
+
+/*
+ * Host stand-in for the OwlProgram FloatArray. Only the subset of the
+ * firmware API used by the patches in this repository is provided, with
+ * plain C loops in place of the CMSIS DSP calls used on the device.
+ */
+
+#include "basicmaths.h"
+#include "message.h"
+
+class FloatArray {
+private:
+  float* data;
+  size_t size;
+public:
+  FloatArray() : data(NULL), size(0) {}
+  FloatArray(float* d, size_t s) : data(d), size(s) {}
+
+  size_t getSize() const {
+    return size;
+  }
+  float* getData(){
+    return data;
+  }
+  operator float*(){
+    return data;
+  }
+  template<typename Index>
+  float& operator[](Index index){
+    return data[index];
+  }
+
+  void clear(){
+    setAll(0);
+  }
+  void setAll(float value){
+    for(size_t i=0; i<size; i++)
+      data[i] = value;
+  }
+  void copyFrom(FloatArray source){
+    copyFrom(source.data, min(size, source.size));
+  }
+  void copyFrom(float* source, size_t len){
+    memcpy(data, source, len*sizeof(float));
+  }
+  void copyTo(FloatArray destination){
+    copyTo(destination.data, min(size, destination.size));
+  }
+  void copyTo(float* destination, size_t len){
+    memcpy(destination, data, len*sizeof(float));
+  }
+  void add(FloatArray operand2){
+    add(operand2, *this);
+  }
+  void add(FloatArray operand2, FloatArray destination){
+    for(size_t i=0; i<size; i++)
+      destination.data[i] = data[i] + operand2.data[i];
+  }
+  void add(float scalar){
+    for(size_t i=0; i<size; i++)
+      data[i] += scalar;
+  }
+  void subtract(FloatArray operand2){
+    for(size_t i=0; i<size; i++)
+      data[i] -= operand2.data[i];
+  }
+  void multiply(FloatArray operand2){
+    multiply(operand2, *this);
+  }
+  void multiply(FloatArray operand2, FloatArray destination){
+    for(size_t i=0; i<size; i++)
+      destination.data[i] = data[i] * operand2.data[i];
+  }
+  void multiply(float scalar){
+    for(size_t i=0; i<size; i++)
+      data[i] *= scalar;
+  }
+  /** fill the array with a linear ramp starting at @param from and approaching @param to */
+  void ramp(float from, float to){
+    float step = (to-from)/size;
+    for(size_t i=0; i<size; i++){
+      data[i] = from;
+      from += step;
+    }
+  }
+  /** scale the array with a linear ramp from @param from to @param to */
+  void scale(float from, float to){
+    float step = (to-from)/size;
+    for(size_t i=0; i<size; i++){
+      data[i] *= from;
+      from += step;
+    }
+  }
+  void tanh(){
+    for(size_t i=0; i<size; i++)
+      data[i] = tanhf(data[i]);
+  }
+  float getMean(){
+    float sum = 0;
+    for(size_t i=0; i<size; i++)
+      sum += data[i];
+    return size ? sum/size : 0;
+  }
+  float getRms(){
+    float sum = 0;
+    for(size_t i=0; i<size; i++)
+      sum += data[i]*data[i];
+    return size ? sqrtf(sum/size) : 0;
+  }
+  FloatArray subArray(int offset, size_t length){
+    ASSERT(offset+length <= size, "Array too small");
+    return FloatArray(data+offset, length);
+  }
+
+  static FloatArray create(int size){
+    float* d = new float[size];
+    FloatArray fa(d, size);
+    fa.clear();
+    return fa;
+  }
+  static void destroy(FloatArray array){
+    delete[] array.data;
+  }
+};
+
+#endif // __FloatArray_h__
@@ -0,0 +1,78 @@
+#ifndef __MidiMessage_h__
+#define __MidiMessage_h__
+
+/*
+ * Host stand-in for the OwlProgram MidiMessage: data[0] holds the USB
+ * cable/code index, data[1..3] the MIDI status and data bytes.
+ */
+
+#include <stdint.h>
+#include "OpenWareMidiControl.h"
+
+class MidiMessage {
+public:
+  uint8_t data[4];
+  MidiMessage(){
+    data[0] = data[1] = data[2] = data[3] = 0;
+  }
+  MidiMessage(uint8_t port, uint8_t d0, uint8_t d1, uint8_t d2){
+    data[0] = port;
+    data[1] = d0;
+    data[2] = d1;
+    data[3] = d2;
+  }
+  uint8_t getPort(){
+    return (data[0] & 0xf0) >> 4;
+  }
+  uint8_t getChannel(){
+    return data[1] & MIDI_CHANNEL_MASK;
+  }
+  uint8_t getStatus(){
+    return data[1] & MIDI_STATUS_MASK;
+  }
+  uint8_t getNote(){
+    return data[2];
+  }
+  uint8_t getVelocity(){
+    return data[3];
+  }
+  uint8_t getControllerNumber(){
+    return data[2];
+  }
+  uint8_t getControllerValue(){
+    return data[3];
+  }
+  int16_t getPitchBend(){
+    return (int16_t)((data[3] << 7) | data[2]) - 8192;
+  }
+  bool isNoteOn(){
+    return getStatus() == NOTE_ON && getVelocity() != 0;
+  }
+  bool isNoteOff(){
+    return getStatus() == NOTE_OFF || (getStatus() == NOTE_ON && getVelocity() == 0);
+  }
+  bool isControlChange(){
+    return getStatus() == CONTROL_CHANGE;
+  }
+  bool isPitchBend(){
+    return getStatus() == PITCH_BEND_CHANGE;
+  }
+  static MidiMessage cc(uint8_t ch, uint8_t cc, uint8_t value){
+    return MidiMessage(0x0b, CONTROL_CHANGE|(ch & 0xf), cc & 0x7f, value & 0x7f);
+  }
+  static MidiMessage pb(uint8_t ch, int16_t value){
+    value += 8192;
+    return MidiMessage(0x0e, PITCH_BEND_CHANGE|(ch & 0xf), value & 0x7f, (value>>7) & 0x7f);
+  }
+  static MidiMessage note(uint8_t ch, uint8_t note, uint8_t velocity){
+    return MidiMessage(0x09, NOTE_ON|(ch & 0xf), note & 0x7f, velocity & 0x7f);
+  }
+  static MidiMessage noteOn(uint8_t ch, uint8_t nt, uint8_t velocity){
+    return MidiMessage::note(ch, nt, velocity);
+  }
+  static MidiMessage noteOff(uint8_t ch, uint8_t note){
+    return MidiMessage(0x08, NOTE_OFF|(ch & 0xf), note & 0x7f, 0);
+  }
+};
+
+#endif // __MidiMessage_h__
@@ -0,0 +1,57 @@
+#ifndef __OpenWareMidiControl_h__
+#define __OpenWareMidiControl_h__
+
+/*
+ * Host stand-in for the OpenWare MIDI definitions used by the patches.
+ */
+
+enum MidiStatus {
+  STATUS_BYTE            = 0x80,
+  NOTE_OFF               = 0x80,
+  NOTE_ON                = 0x90,
+  POLY_KEY_PRESSURE      = 0xA0,
+  CONTROL_CHANGE         = 0xB0,
+  PROGRAM_CHANGE         = 0xC0,
+  CHANNEL_PRESSURE       = 0xD0,
+  PITCH_BEND_CHANGE      = 0xE0,
+  SYSTEM_COMMON          = 0xF0,
+  MIDI_STATUS_MASK       = 0xF0,
+  MIDI_CHANNEL_MASK      = 0x0F
+};
+
+enum MidiControlChange {
+  MIDI_CC_MODULATION     = 1,
+  MIDI_CC_BREATH         = 2,
+  MIDI_CC_VOLUME         = 7,
+  MIDI_CC_BALANCE        = 8,
+  MIDI_CC_PAN            = 10,
+  MIDI_CC_EXPRESSION     = 11,
+  MIDI_CC_SUSTAIN        = 64,
+  MIDI_ALL_SOUND_OFF     = 120,
+  MIDI_RESET_ALL_CTRLS   = 121,
+  MIDI_LOCAL_CONTROL     = 122,
+  MIDI_ALL_NOTES_OFF     = 123
+};
+
+enum OpenWareMidiControl {
+  PATCH_BUTTON           = 4,
+  PATCH_CONTROL          = 5,
+  PATCH_PARAMETER_A      = 20,
+  PATCH_PARAMETER_B      = 21,
+  PATCH_PARAMETER_C      = 22,
+  PATCH_PARAMETER_D      = 23,
+  PATCH_PARAMETER_E      = 24,
+  PATCH_PARAMETER_F      = 1,
+  PATCH_PARAMETER_G      = 12,
+  PATCH_PARAMETER_H      = 13,
+  PATCH_PARAMETER_AA     = 75,
+  PATCH_PARAMETER_AB     = 76,
+  PATCH_PARAMETER_AC     = 77,
+  PATCH_PARAMETER_AD     = 78,
+  PATCH_PARAMETER_AE     = 79,
+  PATCH_PARAMETER_AF     = 80,
+  PATCH_PARAMETER_AG     = 81,
+  PATCH_PARAMETER_AH     = 82
+};
+
+#endif // __OpenWareMidiControl_h__
@@ -0,0 +1,32 @@
+#ifndef __Oscillator_h__
+#define __Oscillator_h__
+
+/*
+ * Host stand-in for the OwlProgram Oscillator interface.
+ */
+
+#include "FloatArray.h"
+
+class Oscillator {
+public:
+  virtual ~Oscillator(){}
+  virtual void setFrequency(float freq) = 0;
+  virtual float getFrequency() = 0;
+  virtual void setPhase(float phase) = 0;
+  virtual float getPhase() = 0;
+  virtual void reset() = 0;
+  virtual float getNextSample() = 0;
+  virtual float getNextSample(float fm){
+    return getNextSample();
+  }
+  virtual void getSamples(FloatArray output){
+    for(size_t i=0; i<output.getSize(); ++i)
+      output[i] = getNextSample();
+  }
+  virtual void getSamples(FloatArray output, FloatArray fm){
+    for(size_t i=0; i<output.getSize(); ++i)
+      output[i] = getNextSample(fm[i]);
+  }
+};
+
+#endif // __Oscillator_h__
@@ -0,0 +1,184 @@
+#ifndef __Patch_h__
+#define __Patch_h__
+
+/*
+ * Host stand-in for the OwlProgram Patch API.
+ *
+ * The firmware gets the sample rate, block size, parameter values and
+ * button state from the program vector. Here they live in a single
+ * PatchHost instance that the benchmark driver configures before it
+ * constructs a patch, and updates between calls to processAudio().
+ */
+
+#include "basicmaths.h"
+#include "message.h"
+#include "FloatArray.h"
+#include "SmoothValue.h"
+#include "MidiMessage.h"
+#include "OpenWareMidiControl.h"
+
+enum PatchParameterId {
+  PARAMETER_A, PARAMETER_B, PARAMETER_C, PARAMETER_D,
+  PARAMETER_E, PARAMETER_F, PARAMETER_G, PARAMETER_H,
+  PARAMETER_AA, PARAMETER_AB, PARAMETER_AC, PARAMETER_AD,
+  PARAMETER_AE, PARAMETER_AF, PARAMETER_AG, PARAMETER_AH,
+  PARAMETER_BA, PARAMETER_BB, PARAMETER_BC, PARAMETER_BD,
+  PARAMETER_BE, PARAMETER_BF, PARAMETER_BG, PARAMETER_BH,
+  PARAMETER_CA, PARAMETER_CB, PARAMETER_CC, PARAMETER_CD,
+  PARAMETER_CE, PARAMETER_CF, PARAMETER_CG, PARAMETER_CH,
+  PARAMETER_DA, PARAMETER_DB, PARAMETER_DC, PARAMETER_DD,
+  PARAMETER_DE, PARAMETER_DF, PARAMETER_DG, PARAMETER_DH,
+  PARAMETER_COUNT
+};
+
+enum PatchButtonId {
+  BYPASS_BUTTON,
+  PUSHBUTTON,
+  GREEN_BUTTON,
+  RED_BUTTON,
+  BUTTON_A,
+  BUTTON_B,
+  BUTTON_C,
+  BUTTON_D,
+  BUTTON_COUNT
+};
+
+enum PatchChannelId {
+  LEFT_CHANNEL = 0,
+  RIGHT_CHANNEL = 1
+};
+
+#define LIN 1.0f
+
+class AudioBuffer {
+private:
+  float* data;
+  int channels;
+  int size;
+public:
+  AudioBuffer(int ch, int sz) : channels(ch), size(sz) {
+    data = new float[channels*size];
+    clear();
+  }
+  ~AudioBuffer(){
+    delete[] data;
+  }
+  FloatArray getSamples(int channel){
+    return FloatArray(data+channel*size, size);
+  }
+  int getChannels(){
+    return channels;
+  }
+  int getSize(){
+    return size;
+  }
+  void clear(){
+    memset(data, 0, channels*size*sizeof(float));
+  }
+  static AudioBuffer* create(int channels, int samples){
+    return new AudioBuffer(channels, samples);
+  }
+  static void destroy(AudioBuffer* buffer){
+    delete buffer;
+  }
+};
+
+class PatchHost {
+public:
+  float sampleRate;
+  int blockSize;
+  float parameters[PARAMETER_COUNT];
+  const char* names[PARAMETER_COUNT];
+  uint16_t buttons[BUTTON_COUNT];
+  unsigned int midiOut;
+  float elapsedBlockTime; // fraction of the block processed when MIDI arrives
+  PatchHost(){
+    configure(48000, 64);
+  }
+  void configure(float sr, int bs){
+    sampleRate = sr;
+    blockSize = bs;
+    for(int i=0; i<PARAMETER_COUNT; i++){
+      parameters[i] = 0;
+      names[i] = NULL;
+    }
+    for(int i=0; i<BUTTON_COUNT; i++)
+      buttons[i] = 0;
+    midiOut = 0;
+    elapsedBlockTime = 0;
+  }
+  bool isRegistered(PatchParameterId pid){
+    return names[pid] != NULL;
+  }
+  static PatchHost& get(){
+    static PatchHost host;
+    return host;
+  }
+};
+
+class FloatParameter {
+private:
+  PatchParameterId pid;
+  float minimum;
+  float maximum;
+public:
+  FloatParameter() : pid(PARAMETER_A), minimum(0), maximum(1) {}
+  FloatParameter(PatchParameterId p, float mn, float mx) : pid(p), minimum(mn), maximum(mx) {}
+  float getValue() const {
+    return minimum + (maximum - minimum)*PatchHost::get().parameters[pid];
+  }
+  operator float() const {
+    return getValue();
+  }
+};
+
+class Patch {
+public:
+  Patch(){}
+  virtual ~Patch(){}
+  void registerParameter(PatchParameterId pid, const char* name){
+    PatchHost::get().names[pid] = name;
+  }
+  float getParameterValue(PatchParameterId pid){
+    return PatchHost::get().parameters[pid];
+  }
+  void setParameterValue(PatchParameterId pid, float value){
+    PatchHost::get().parameters[pid] = value;
+  }
+  bool isButtonPressed(PatchButtonId bid){
+    return PatchHost::get().buttons[bid] != 0;
+  }
+  void setButton(PatchButtonId bid, uint16_t value, uint16_t samples = 0){
+    PatchHost::get().buttons[bid] = value;
+  }
+  FloatParameter getFloatParameter(const char* name, float min, float max, float defaultValue = 0.0f,
+				   float lambda = 0.0f, float delta = 0.0f, float skew = LIN){
+    PatchHost& host = PatchHost::get();
+    int pid = PARAMETER_A;
+    while(pid < PARAMETER_COUNT-1 && host.isRegistered((PatchParameterId)pid))
+      pid++;
+    registerParameter((PatchParameterId)pid, name);
+    if(max > min){
+      float value = (defaultValue - min)/(max - min);
+      host.parameters[pid] = value < 0 ? 0 : value > 1 ? 1 : value;
+    }
+    return FloatParameter((PatchParameterId)pid, min, max);
+  }
+  float getSampleRate(){
+    return PatchHost::get().sampleRate;
+  }
+  int getBlockSize(){
+    return PatchHost::get().blockSize;
+  }
+  float getElapsedBlockTime(){
+    return PatchHost::get().elapsedBlockTime;
+  }
+  void sendMidi(MidiMessage msg){
+    PatchHost::get().midiOut++;
+  }
+  virtual void buttonChanged(PatchButtonId bid, uint16_t value, uint16_t samples){}
+  virtual void processMidi(MidiMessage msg){}
+  virtual void processAudio(AudioBuffer& output) = 0;
+};
+
+#endif // __Patch_h__
@@ -0,0 +1,54 @@
+#ifndef __RampOscillator_h__
+#define __RampOscillator_h__
+
+/*
+ * Host stand-in for the OwlProgram RampOscillator: normalised phase,
+ * output ramps from -1 to 1.
+ */
+
+#include "Oscillator.h"
+
+class RampOscillator : public Oscillator {
+private:
+  float mul;
+  float phase;
+  float incr;
+public:
+  RampOscillator(float sr = 48000) : mul(1/sr), phase(0), incr(0) {}
+  void setSampleRate(float sr){
+    float freq = getFrequency();
+    mul = 1/sr;
+    setFrequency(freq);
+  }
+  void setFrequency(float freq){
+    incr = freq*mul;
+  }
+  float getFrequency(){
+    return incr/mul;
+  }
+  void setPhase(float ph){
+    phase = ph;
+  }
+  float getPhase(){
+    return phase;
+  }
+  void reset(){
+    phase = 0;
+  }
+  float getNextSample(){
+    float sample = phase*2 - 1;
+    phase += incr;
+    if(phase >= 1)
+      phase -= 1;
+    return sample;
+  }
+  using Oscillator::getSamples;
+  static RampOscillator* create(float sr){
+    return new RampOscillator(sr);
+  }
+  static void destroy(RampOscillator* osc){
+    delete osc;
+  }
+};
+
+#endif // __RampOscillator_h__
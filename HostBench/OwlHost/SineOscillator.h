@@ -0,0 +1,63 @@
+#ifndef __SineOscillator_h__
+#define __SineOscillator_h__
+
+/*
+ * Host stand-in for the OwlProgram SineOscillator: phase in radians,
+ * one sinf() call per sample, FM added to the phase increment.
+ */
+
+#include "Oscillator.h"
+
+class SineOscillator : public Oscillator {
+private:
+  float mul;
+  float phase;
+  float incr;
+public:
+  SineOscillator(float sr = 48000) : mul(2*M_PI/sr), phase(0), incr(0) {}
+  void setSampleRate(float sr){
+    float freq = getFrequency();
+    mul = 2*M_PI/sr;
+    setFrequency(freq);
+  }
+  void setFrequency(float freq){
+    incr = freq*mul;
+  }
+  float getFrequency(){
+    return incr/mul;
+  }
+  void setPhase(float ph){
+    phase = ph;
+  }
+  float getPhase(){
+    return phase;
+  }
+  void reset(){
+    phase = 0;
+  }
+  float getNextSample(){
+    float sample = sinf(phase);
+    phase += incr;
+    if(phase >= 2*M_PI)
+      phase -= 2*M_PI;
+    return sample;
+  }
+  float getNextSample(float fm){
+    float sample = sinf(phase);
+    phase += incr + fm;
+    if(phase >= 2*M_PI)
+      phase -= 2*M_PI;
+    else if(phase < 0)
+      phase += 2*M_PI;
+    return sample;
+  }
+  using Oscillator::getSamples;
+  static SineOscillator* create(float sr){
+    return new SineOscillator(sr);
+  }
+  static void destroy(SineOscillator* osc){
+    delete osc;
+  }
+};
+
+#endif // __SineOscillator_h__
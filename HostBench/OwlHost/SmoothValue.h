@@ -0,0 +1,73 @@
+#ifndef __SmoothValue_h__
+#define __SmoothValue_h__
+
+/*
+ * Host stand-in for the OwlProgram SmoothValue and StiffValue templates.
+ */
+
+#include "basicmaths.h"
+
+/**
+ * Applies exponential smoothing to a value, ie a one-pole lowpass filter.
+ */
+template<typename T>
+class SmoothValue {
+protected:
+  T value;
+public:
+  T lambda;
+  SmoothValue() : value(0), lambda(0.9) {}
+  SmoothValue(T l) : value(0), lambda(l) {}
+  SmoothValue(T l, T initialValue) : value(initialValue), lambda(l) {}
+  void update(T newValue){
+    value = value*lambda + newValue*(1.0f - lambda);
+  }
+  T getValue(){
+    return value;
+  }
+  SmoothValue<T>& operator=(const T& other){
+    update(other);
+    return *this;
+  }
+  operator T(){
+    return getValue();
+  }
+};
+
+/**
+ * Applies simple hysteresis to a value: it only changes when the new
+ * value moves by more than delta.
+ */
+template<typename T>
+class StiffValue {
+protected:
+  T value;
+public:
+  T delta;
+  StiffValue() : value(0), delta(0.02) {}
+  StiffValue(T d) : value(0), delta(d) {}
+  StiffValue(T d, T initialValue) : value(initialValue), delta(d) {}
+  void update(T newValue){
+    if(newValue > value + delta)
+      value = newValue - delta;
+    else if(newValue < value - delta)
+      value = newValue + delta;
+  }
+  T getValue(){
+    return value;
+  }
+  StiffValue<T>& operator=(const T& other){
+    update(other);
+    return *this;
+  }
+  operator T(){
+    return getValue();
+  }
+};
+
+typedef SmoothValue<float> SmoothFloat;
+typedef SmoothValue<int> SmoothInt;
+typedef StiffValue<float> StiffFloat;
+typedef StiffValue<int> StiffInt;
+
+#endif // __SmoothValue_h__
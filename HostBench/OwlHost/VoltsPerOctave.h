@@ -0,0 +1,64 @@
+#ifndef __VoltsPerOctave_h__
+#define __VoltsPerOctave_h__
+
+/*
+ * Host stand-in for the OwlProgram VoltsPerOctave converter. The default
+ * input and output calibration mirrors the firmware defaults closely
+ * enough for benchmarking; it is not a calibrated model of the module.
+ */
+
+#include "FloatArray.h"
+
+class VoltsPerOctave {
+private:
+  float offset;
+  float multiplier;
+  float tune;
+public:
+  VoltsPerOctave(bool input = true) : tune(0) {
+    if(input){
+      offset = 0;
+      multiplier = -4.29f;
+    }else{
+      offset = 0;
+      multiplier = -5.0f;
+    }
+  }
+  VoltsPerOctave(float o, float m) : offset(o), multiplier(m), tune(0) {}
+  void setTune(float octaves){
+    tune = octaves;
+  }
+  float getTune(){
+    return tune;
+  }
+  float getFrequency(float sample){
+    return voltsToHertz(sampleToVolts(sample));
+  }
+  void getFrequency(FloatArray samples, FloatArray output){
+    for(size_t i=0; i<samples.getSize(); i++)
+      output[i] = getFrequency(samples[i]);
+  }
+  float sampleToVolts(float sample){
+    return (sample - offset) * multiplier;
+  }
+  float voltsToHertz(float volts){
+    return 440.f * exp2f(volts + tune);
+  }
+  float hertzToVolts(float hz){
+    return log2f(hz/440.0f) - tune;
+  }
+  float voltsToSample(float volts){
+    return volts / multiplier + offset;
+  }
+  float getSample(float frequency){
+    return voltsToSample(hertzToVolts(frequency));
+  }
+  static float hertzToNote(float hertz){
+    return 12 * log2f(hertz / 440.0f) + 69;
+  }
+  static float noteToHertz(float note){
+    return 440.0f * exp2f((note - 69) / 12.0f);
+  }
+};
+
+#endif // __VoltsPerOctave_h__
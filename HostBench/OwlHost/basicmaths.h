@@ -0,0 +1,29 @@
+#ifndef __basicmaths_h__
+#define __basicmaths_h__
+
+/*
+ * Host stand-in for the OwlProgram basicmaths.h.
+ * Like the firmware library, min/max/abs are macros, so any standard C++
+ * headers must be included before this file.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#ifndef min
+#define min(a,b) ((a)<(b)?(a):(b))
+#endif
+#ifndef max
+#define max(a,b) ((a)>(b)?(a):(b))
+#endif
+#ifndef abs
+#define abs(x) ((x)>0?(x):-(x))
+#endif
+
+#endif // __basicmaths_h__
@@ -0,0 +1,42 @@
+#ifndef __message_h__
+#define __message_h__
+
+/*
+ * Host stand-in for the OwlProgram message.h: assertions abort the
+ * benchmark, debug messages go to stderr.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ASSERT(cond, msg) do{ if(!(cond)){ fprintf(stderr, "Assertion failed: %s (%s:%d)\n", msg, __FILE__, __LINE__); abort(); } }while(0)
+
+inline void debugMessage(const char* msg){
+  fprintf(stderr, "%s\n", msg);
+}
+
+inline void debugMessage(const char* msg, int a){
+  fprintf(stderr, "%s %d\n", msg, a);
+}
+
+inline void debugMessage(const char* msg, int a, int b){
+  fprintf(stderr, "%s %d %d\n", msg, a, b);
+}
+
+inline void debugMessage(const char* msg, int a, int b, int c){
+  fprintf(stderr, "%s %d %d %d\n", msg, a, b, c);
+}
+
+inline void debugMessage(const char* msg, float a){
+  fprintf(stderr, "%s %f\n", msg, a);
+}
+
+inline void debugMessage(const char* msg, float a, float b){
+  fprintf(stderr, "%s %f %f\n", msg, a, b);
+}
+
+inline void debugMessage(const char* msg, float a, float b, float c){
+  fprintf(stderr, "%s %f %f %f\n", msg, a, b, c);
+}
+
+#endif // __message_h__
@@ -0,0 +1,271 @@
+/**
+
+DESCRIPTION:
+    Offline host renderer and per-block timing benchmark for the C++ patches.
+
+    The patch under test is chosen at compile time with PATCH_HEADER,
+    PATCH_CLASS and PATCH_NAME (see Makefile). For every requested block
+    size the patch is constructed fresh, fed a deterministic stereo test
+    signal, tap tempo presses and MIDI notes, and each processAudio() call
+    is timed individually. MIDI notes arrive part way into the block, as
+    reported by getElapsedBlockTime(). Parameters are either left at the values the
+    patch sets in its constructor ("static") or swept with independent
+    triangle LFOs ("sweep").
+
+    Reported per run: mean ns/block, ns/sample, worst-case block time and
+    the mean and worst load as a percentage of the real-time budget
+    (blocksize / samplerate).
+
+    Patches that place their buffers with MemoryTiers get a simulated
+    fast region, of -f kilobytes, and a bulk region, in place of the
+    regions they reserve from the heap on the device. Built with
+    MEMORY_TIER_ACCOUNTING defined, every run is followed by the bytes
+    accessed per sample in each region, and their weighted cost.
+
+USAGE:
+    bench_<Patch> [-r samplerate] [-b 16,32,...] [-s seconds] [-m static|sweep|both] [-f kB] [-o file]
+
+    -o appends the rendered output of every run to a raw, interleaved
+    32-bit float file, so the output of two builds can be compared.
+
+    Returns 1 if any run renders a sample that is not finite.
+*/
+
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "Patch.h"
+#include PATCH_HEADER
+
+enum BenchMode {
+  MODE_STATIC = 1,
+  MODE_SWEEP = 2,
+  MODE_BOTH = 3
+};
+
+struct BenchResult {
+  double mean;
+  double worst;
+  size_t blocks;
+  size_t invalid; // samples that are not finite
+};
+
+class Stimulus {
+private:
+  uint32_t seed;
+  float sr;
+  size_t sampleCount;
+public:
+  Stimulus(float samplerate) : seed(22222), sr(samplerate), sampleCount(0) {}
+  float noise(){
+    seed = seed*1664525 + 1013904223;
+    return (int32_t)seed * (1.0f/2147483648.0f);
+  }
+  /* tone bursts with a little noise: on for 250ms of every second */
+  void generate(AudioBuffer& buffer){
+    FloatArray left = buffer.getSamples(LEFT_CHANNEL);
+    FloatArray right = buffer.getSamples(RIGHT_CHANNEL);
+    for(int i=0; i<buffer.getSize(); i++){
+      float t = sampleCount++/sr;
+      float gate = fmodf(t, 1.0f) < 0.25f ? 1.0f : 0.0f;
+      left[i] = gate*0.3f*sinf(2*M_PI*110*t) + 0.05f*noise();
+      right[i] = gate*0.3f*sinf(2*M_PI*165*t) + 0.05f*noise();
+    }
+  }
+};
+
+static bool isInputParameter(const char* name){
+  return name != NULL && name[strlen(name)-1] != '>';
+}
+
+static float triangle(float phase){
+  phase = phase - floorf(phase);
+  return phase < 0.5f ? phase*2 : 2 - phase*2;
+}
+
+static BenchResult render(int blocksize, float samplerate, float seconds, bool sweep, FILE* output){
+  PatchHost& host = PatchHost::get();
+  host.configure(samplerate, blocksize);
+#ifdef __MemoryTier_hpp__
+  MemoryTiers::get().resetAccessed();
+#endif
+  PATCH_CLASS* patch = new PATCH_CLASS();
+  AudioBuffer* buffer = AudioBuffer::create(2, blocksize);
+  Stimulus stimulus(samplerate);
+  std::vector<float> interleaved(blocksize*2);
+
+  size_t blocks = seconds*samplerate/blocksize;
+  size_t warmup = blocks/20;
+  size_t tapInterval = samplerate/2/blocksize;      // 120 BPM
+  size_t noteInterval = samplerate/4/blocksize;     // 16th notes
+  uint8_t notes[] = { 48, 55, 60, 63, 67, 72, 70, 58 };
+  double total = 0;
+  double worst = 0;
+  size_t invalid = 0;
+
+  for(size_t block=0; block<blocks; block++){
+    float t = block*blocksize/samplerate;
+    if(sweep){
+      for(int pid=0; pid<PARAMETER_COUNT; pid++){
+	if(isInputParameter(host.names[pid]))
+	  host.parameters[pid] = triangle(t/(3.0f+pid*0.7f) + pid*0.13f);
+      }
+    }
+    if(tapInterval && block % tapInterval == 0){
+      host.buttons[BUTTON_A] = 4095;
+      patch->buttonChanged(BUTTON_A, 4095, (block*37) % blocksize);
+    }else if(tapInterval && block % tapInterval == 1){
+      host.buttons[BUTTON_A] = 0;
+      patch->buttonChanged(BUTTON_A, 0, 0);
+    }
+    if(noteInterval && block % noteInterval == 0){
+      uint8_t note = notes[(block/noteInterval) % sizeof(notes)];
+      uint8_t previous = notes[(block/noteInterval + sizeof(notes) - 1) % sizeof(notes)];
+      host.elapsedBlockTime = (float)((block*37) % blocksize)/blocksize;
+      patch->processMidi(MidiMessage::note(0, note, 100));
+      patch->processMidi(MidiMessage::noteOff(0, previous));
+      host.elapsedBlockTime = 0;
+    }
+    stimulus.generate(*buffer);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    patch->processAudio(*buffer);
+    std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+    for(int ch=0; ch<2; ch++){
+      FloatArray samples = buffer->getSamples(ch);
+      for(int i=0; i<blocksize; i++)
+	invalid += !std::isfinite(samples[i]);
+    }
+    if(block >= warmup){
+      total += ns;
+      if(ns > worst)
+	worst = ns;
+    }
+    if(output != NULL){
+      FloatArray left = buffer->getSamples(LEFT_CHANNEL);
+      FloatArray right = buffer->getSamples(RIGHT_CHANNEL);
+      for(int i=0; i<blocksize; i++){
+	interleaved[i*2] = left[i];
+	interleaved[i*2+1] = right[i];
+      }
+      fwrite(interleaved.data(), sizeof(float), interleaved.size(), output);
+    }
+  }
+  delete patch;
+  AudioBuffer::destroy(buffer);
+
+  BenchResult result;
+  result.blocks = blocks - warmup;
+  result.mean = result.blocks ? total/result.blocks : 0;
+  result.worst = worst;
+  result.invalid = invalid;
+  return result;
+}
+
+static std::vector<int> parseBlockSizes(const char* arg){
+  std::vector<int> sizes;
+  std::string list(arg);
+  size_t pos = 0;
+  while(pos < list.size()){
+    size_t next = list.find(',', pos);
+    if(next == std::string::npos)
+      next = list.size();
+    int size = atoi(list.substr(pos, next-pos).c_str());
+    if(size > 0)
+      sizes.push_back(size);
+    pos = next+1;
+  }
+  return sizes;
+}
+
+static void usage(const char* name){
+  fprintf(stderr, "usage: %s [-r samplerate] [-b 16,32,...] [-s seconds] [-m static|sweep|both] [-f kB] [-o file]\n", name);
+}
+
+int main(int argc, char** argv){
+  float samplerate = 48000;
+  float seconds = 10;
+  int mode = MODE_BOTH;
+  std::vector<int> blocksizes = parseBlockSizes("16,32,64,128,256,512");
+  FILE* output = NULL;
+  bool valid = true;
+  int fast = 256;
+  int opt;
+  while((opt = getopt(argc, argv, "r:b:s:m:f:o:h")) != -1){
+    switch(opt){
+    case 'r':
+      samplerate = atof(optarg);
+      break;
+    case 'b':
+      blocksizes = parseBlockSizes(optarg);
+      break;
+    case 's':
+      seconds = atof(optarg);
+      break;
+    case 'm':
+      if(strcmp(optarg, "static") == 0)
+	mode = MODE_STATIC;
+      else if(strcmp(optarg, "sweep") == 0)
+	mode = MODE_SWEEP;
+      else
+	mode = MODE_BOTH;
+      break;
+    case 'f':
+      fast = atoi(optarg);
+      break;
+    case 'o':
+      output = fopen(optarg, "wb");
+      if(output == NULL){
+	perror(optarg);
+	return 1;
+      }
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+#ifdef __MemoryTier_hpp__
+  // internal SRAM left after the program, and external SDRAM
+  MemoryTiers::get().reserve(FAST_LOCATION, fast*1024);
+  MemoryTiers::get().reserve(BULK_LOCATION, 16*1024*1024);
+#endif
+  printf("# %s: %.0f Hz, %.1f s per run\n", PATCH_NAME, samplerate, seconds);
+  printf("# %-7s %6s %12s %10s %12s %8s %8s\n", "mode", "block", "ns/block", "ns/sample", "worst(ns)", "load%", "worst%");
+  for(size_t i=0; i<blocksizes.size(); i++){
+    int blocksize = blocksizes[i];
+    double budget = 1e9*blocksize/samplerate;
+    for(int m=MODE_STATIC; m<=MODE_SWEEP; m++){
+      if((mode & m) == 0)
+	continue;
+      BenchResult result = render(blocksize, samplerate, seconds, m == MODE_SWEEP, output);
+      printf("  %-7s %6d %12.1f %10.2f %12.1f %8.2f %8.2f\n",
+	     m == MODE_SWEEP ? "sweep" : "static", blocksize,
+	     result.mean, result.mean/blocksize, result.worst,
+	     100*result.mean/budget, 100*result.worst/budget);
+      if(result.invalid){
+	printf("#   %d samples are not finite\n", (int)result.invalid);
+	valid = false;
+      }
+#if defined(MEMORY_TIER_ACCOUNTING) && defined(__MemoryTier_hpp__)
+      MemoryTiers& tiers = MemoryTiers::get();
+      double samples = (double)seconds*samplerate;
+      printf("#   bytes/sample fast %.1f bulk %.1f heap %.1f, cost %.1f\n",
+	     tiers.getAccessed(FAST_LOCATION)/samples, tiers.getAccessed(BULK_LOCATION)/samples,
+	     tiers.getAccessed(HEAP_LOCATION)/samples, tiers.getAccessCost()/samples);
+#endif
+      fflush(stdout);
+    }
+  }
+  if(output != NULL)
+    fclose(output);
+  return valid ? 0 : 1;
+}
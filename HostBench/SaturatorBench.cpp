@@ -0,0 +1,66 @@
+/**
+
+DESCRIPTION:
+    Accuracy and speed of the Saturator modes against tanhf(), as used
+    by FloatArray::tanh(). The error is the largest absolute difference
+    from tanh over inputs in [-8, 8]; the time is for in-place block
+    processing of inputs in [-3, 3].
+*/
+
+#include <chrono>
+#include <stdio.h>
+
+#include "FloatArray.h"
+#include "Saturator.hpp"
+
+static const size_t BLOCKSIZE = 64;
+static const size_t SAMPLES = 1<<24;
+
+class TanhSaturator {
+public:
+  float process(float x){
+    return tanhf(x);
+  }
+  void process(FloatArray buf){
+    buf.tanh();
+  }
+};
+
+template<class Sat>
+void run(const char* name, Sat& saturator, FloatArray input, FloatArray block, float& checksum){
+  double error = 0;
+  for(int i=-800000; i<=800000; i++){
+    float x = i*1e-5f;
+    error = max(error, fabs(saturator.process(x) - tanh((double)x)));
+  }
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(size_t n=0; n<SAMPLES; n+=BLOCKSIZE){
+    block.copyFrom(input);
+    saturator.process(block);
+    checksum += block[n & (BLOCKSIZE-1)];
+  }
+  std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(stop - start).count()/SAMPLES;
+  printf("  %-8s %12.3g %12.3f\n", name, error, ns);
+}
+
+int main(){
+  FloatArray input = FloatArray::create(BLOCKSIZE);
+  FloatArray block = FloatArray::create(BLOCKSIZE);
+  for(size_t i=0; i<BLOCKSIZE; i++)
+    input[i] = 3.0f*sinf(i*0.37f);
+  float checksum = 0;
+  TanhSaturator tanh;
+  Saturator<PADE_SATURATOR> pade;
+  Saturator<CUBIC_SATURATOR> cubic;
+  Saturator<TABLE_SATURATOR> table;
+  printf("# Saturator: max error against tanh, ns/sample, block size %d\n", (int)BLOCKSIZE);
+  printf("# %-8s %12s %12s\n", "mode", "max error", "ns/sample");
+  run("tanhf", tanh, input, block, checksum);
+  run("pade", pade, input, block, checksum);
+  run("cubic", cubic, input, block, checksum);
+  run("table", table, input, block, checksum);
+  FloatArray::destroy(input);
+  FloatArray::destroy(block);
+  return checksum == 12345.0f;
+}
@@ -0,0 +1,63 @@
+#ifndef __MidiEventQueue_hpp__
+#define __MidiEventQueue_hpp__
+
+#include "MidiMessage.h"
+
+#define MIDI_EVENT_QUEUE_SIZE 32
+
+/**
+ * A MIDI message due @param samples into the next audio block.
+ */
+class MidiEvent {
+public:
+  MidiMessage msg;
+  uint16_t samples;
+};
+
+/**
+ * Fixed capacity queue of timestamped MIDI events, kept in time order:
+ * events are pushed as they arrive and popped when the audio block they
+ * fall in is processed. Events with the same offset keep the order they
+ * arrived in.
+ */
+class MidiEventQueue {
+private:
+  MidiEvent events[MIDI_EVENT_QUEUE_SIZE];
+  size_t head = 0;
+  size_t count = 0;
+  MidiEvent& at(size_t index){
+    return events[(head + index) % MIDI_EVENT_QUEUE_SIZE];
+  }
+public:
+  bool isEmpty(){
+    return count == 0;
+  }
+
+  bool isFull(){
+    return count == MIDI_EVENT_QUEUE_SIZE;
+  }
+
+  /**
+   * insert @param msg, due @param samples into the block, behind any
+   * event due at the same time or earlier. The queue must not be full.
+   */
+  void push(MidiMessage msg, uint16_t samples){
+    ASSERT(!isFull(), "MIDI event queue overflow");
+    size_t i = count++;
+    while(i > 0 && at(i-1).samples > samples){
+      at(i) = at(i-1);
+      i--;
+    }
+    at(i).msg = msg;
+    at(i).samples = samples;
+  }
+
+  MidiEvent pop(){
+    MidiEvent event = at(0);
+    head = (head + 1) % MIDI_EVENT_QUEUE_SIZE;
+    count--;
+    return event;
+  }
+};
+
+#endif // __MidiEventQueue_hpp__
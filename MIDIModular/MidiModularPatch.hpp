@@ -39,11 +39,20 @@ DESCRIPTION:
     - CC 1 Modulation on CV Out 1
     - CC 11 Expression to CV Out 2
     - Parameters C and D adds FM sine osc to pitch output
+
+    Notes, pitchbend and all notes off are queued with the sample offset
+    they are due at, and each block is split at the events in it, so
+    pitch and pitchbend step and the gate changes on the sample the event
+    is due. The firmware delivers MIDI with no timestamp: its offset is
+    the part of the block that had elapsed when the message arrived, so
+    it takes effect one block later, at the same place in the block.
+    The last note held sets the pitch.
 */
 
 #include "Patch.h"
 #include "SineOscillator.h"
 #include "VoltsPerOctave.h"
+#include "MidiEventQueue.hpp"
 
 // #define ROOT_NOTE 69 // A4
 #define ROOT_NOTE 33 // A1
@@ -56,12 +65,63 @@ class MonoVoiceAllocator {
     float& bend;
     uint8_t notes[16];
     uint8_t lastNote = 0;
+    uint8_t note = ROOT_NOTE;
+    int16_t pitchbend = 0;
+    MidiEventQueue events;
+
+    void apply(MidiMessage msg) {
+        if (msg.isNoteOn()) {
+            press(msg.getNote(), (uint16_t)msg.getVelocity() << 5);
+        }
+        else if (msg.isNoteOff()) {
+            release(msg.getNote());
+        }
+        else if (msg.isPitchBend()) {
+            setPitchBend(msg.getPitchBend());
+        }
+        else if (msg.isControlChange()) {
+            if (msg.getControllerNumber() == MIDI_ALL_NOTES_OFF)
+                allNotesOff();
+        }
+    }
+    void press(uint8_t nt, uint16_t velocity) {
+        if (lastNote < 16)
+            notes[lastNote++] = nt;
+        note = nt;
+        freq = noteToHz(nt);
+        gain = velocityToGain(velocity);
+        gate = 1.0f;
+    }
+    void release(uint8_t nt) {
+        int i;
+        for (i = 0; i < lastNote; ++i) {
+            if (notes[i] == nt)
+                break;
+        }
+        if (i == lastNote)
+            return; // not held
+        if (lastNote > 1) {
+            lastNote--;
+            while (i < lastNote) {
+                notes[i] = notes[i + 1];
+                i++;
+            }
+            note = notes[lastNote - 1];
+            freq = noteToHz(note);
+        }
+        else {
+            gate = 0.0f;
+            lastNote = 0;
+        }
+    }
 public:
     MonoVoiceAllocator(float& fq, float& gn, float& gt, float& bd)
         : freq(fq)
         , gain(gn)
         , gate(gt)
         , bend(bd) {
+        freq = noteToHz(note);
+        bend = 1.0f;
     }
     float getFreq() {
         return freq;
@@ -75,25 +135,30 @@ public:
     float getBend() {
         return bend;
     }
-    void processMidi(MidiMessage msg) {
-        uint16_t samples = 0;
-        if (msg.isNoteOn()) {
-            noteOn(msg.getNote(), (uint16_t)msg.getVelocity() << 5, samples);
-        }
-        else if (msg.isNoteOff()) {
-            noteOff(msg.getNote(), (uint16_t)msg.getVelocity() << 5, samples);
-        }
-        else if (msg.isPitchBend()) {
-            setPitchBend(msg.getPitchBend());
-        }
-        else if (msg.isControlChange()) {
-            if (msg.getControllerNumber() == MIDI_ALL_NOTES_OFF)
-                allNotesOff();
+    uint8_t getNote() {
+        return note;
+    }
+    /* the pitchbend from -1 to 1 */
+    float getPitchBend() {
+        return pitchbend / 8192.0f;
+    }
+    /**
+     * queue @param msg to take effect @param samples into the next block.
+     * If the queue is full, the earliest event is applied at once to make
+     * room. Messages that do not change the voice are ignored.
+     */
+    void processMidi(MidiMessage msg, uint16_t samples = 0) {
+        if (msg.isNoteOn() || msg.isNoteOff() || msg.isPitchBend() ||
+            (msg.isControlChange() && msg.getControllerNumber() == MIDI_ALL_NOTES_OFF)) {
+            if (events.isFull())
+                apply(events.pop().msg);
+            events.push(msg, samples);
         }
     }
     void setPitchBend(int16_t pb) {
         float fb = pb * (2.0f / 8192.0f);
         bend = exp2f(fb);
+        pitchbend = pb;
     }
     float noteToHz(uint8_t note) {
         return 440.0f * exp2f((note - ROOT_NOTE) / 12.0);
@@ -102,42 +167,38 @@ public:
         return exp2f(velocity / 4095.0f) - 1;
     }
     void noteOn(uint8_t note, uint16_t velocity, uint16_t delay) {
-        if (lastNote < 16)
-            notes[lastNote++] = note;
-        freq = noteToHz(note);
-        gain = velocityToGain(velocity);
-        gate = 1.0f;
+        processMidi(MidiMessage::note(0, note, velocity >> 5), delay);
     }
     void noteOff(uint8_t note, uint16_t velocity, uint16_t delay) {
-        int i;
-        for (i = 0; i < lastNote; ++i) {
-            if (notes[i] == note)
-                break;
-        }
-        if (lastNote > 1) {
-            lastNote--;
-            while (i < lastNote) {
-                notes[i] = notes[i + 1];
-                i++;
-            }
-            freq = noteToHz(notes[lastNote - 1]);
-        }
-        else {
-            gate = 0.0f;
-            lastNote = 0;
-        }
+        processMidi(MidiMessage::noteOff(0, note), delay);
     }
     void allNotesOff() {
         lastNote = 0;
-        bend = 0;
+        gate = 0.0f;
+        setPitchBend(0);
+    }
+    /**
+     * apply the events due in the next @param len samples in time order,
+     * calling @param segment(from, to) for each run of samples over which
+     * the voice does not change
+     */
+    template<typename Segment>
+    void process(size_t len, Segment segment) {
+        size_t pos = 0;
+        while (!events.isEmpty()) {
+            MidiEvent event = events.pop();
+            size_t due = min((size_t)event.samples, len);
+            if (due > pos) {
+                segment(pos, due);
+                pos = due;
+            }
+            apply(event.msg);
+        }
+        if (len > pos)
+            segment(pos, len);
     }
 };
 
-static float fFreq, fGain, fGate;
-static float fBend = 1.0f;
-
-MonoVoiceAllocator allocator(fFreq, fGain, fGate, fBend);
-
 class State {
 public:
   int channel = 0;
@@ -157,10 +218,14 @@ private:
   VoltsPerOctave voltsIn;
   State in;
   State out;
-  float saveLeft = 0;
-  float saveRight = 0;
+  float freq;
+  float gain;
+  float gate;
+  float bend;
+  MonoVoiceAllocator allocator;
 public:
-  MidiModularPatch() : voltsIn(true), voltsOut(false) {
+  MidiModularPatch() : voltsIn(true), voltsOut(false), gain(0), gate(0),
+		       allocator(freq, gain, gate, bend) {
     osc.setSampleRate(getSampleRate());
     fm = FloatArray::create(getBlockSize());
     registerParameter(PARAMETER_A, "Modulation");
@@ -171,32 +236,27 @@ public:
     registerParameter(PARAMETER_G, "Expression>");
   }
 
+  /* MIDI from the firmware is due as far into the next block as it arrived into this one */
   void processMidi(MidiMessage msg){
-    switch(msg.getStatus()) {
-    case NOTE_OFF:
-      msg.data[3] = 0;
-      // deliberate fall-through
-    case NOTE_ON:
-      if(!in.velocity){
-	in.note = msg.getNote();
-	in.velocity = msg.getVelocity();
-      }else if(msg.getNote() == in.note){
-	in.velocity = 0;
-      }
-      break;
-    case PITCH_BEND_CHANGE:
-      in.pitchbend = msg.getPitchBend()/8192.0f;
-      break;
-    case CONTROL_CHANGE:
+    processMidi(msg, getElapsedBlockTime()*getBlockSize());
+  }
+
+  /**
+   * queue @param msg to take effect @param samples into the next block.
+   * CCs 1 and 11 take effect at once: they only set parameters, once a block.
+   */
+  void processMidi(MidiMessage msg, uint16_t samples){
+    if(msg.isControlChange()){
       switch(msg.getControllerNumber()){
       case MIDI_CC_MODULATION:
 	in.modulation = msg.getControllerValue();
-	break;
+	return;
       case MIDI_CC_EXPRESSION:
 	in.expression = msg.getControllerValue();
-	break;
+	return;
       }
     }
+    allocator.processMidi(msg, min((int)samples, getBlockSize()-1));
   }
   
   void buttonChanged(PatchButtonId bid, uint16_t value, uint16_t samples){
@@ -234,22 +294,22 @@ public:
       out.expression = cc;
     }
 
-    // MIDI to CV
-    in.freq = voltsOut.noteToHertz(in.note - ROOT_NOTE_OFFSET);
-    float value = voltsOut.getSample(in.freq);
-    left.ramp(saveLeft, value);
-    saveLeft = value;
-    right.ramp(saveRight, in.pitchbend);
-    saveRight = in.pitchbend;
+    // MIDI to CV, split at each event due in the block
+    bool open = gate != 0;
+    setButton(PUSHBUTTON, open ? 4095 : 0, 0);
+    allocator.process(left.getSize(), [&](size_t from, size_t to){
+	if(open != (gate != 0)){
+	  open = gate != 0;
+	  setButton(PUSHBUTTON, open ? 4095 : 0, from);
+	}
+	left.subArray(from, to-from).setAll(voltsOut.getSample(freq));
+	right.subArray(from, to-from).setAll(allocator.getPitchBend());
+      });
     setParameterValue(PARAMETER_F, in.modulation/127.0f);
     setParameterValue(PARAMETER_G, in.expression/127.0f);
-    if(in.velocity)
-      setButton(PUSHBUTTON, 4095, 0);      
-    else
-      setButton(PUSHBUTTON, 0, 0);
 
     // add a little oscillation
-    osc.setFrequency(voltsOut.noteToHertz(in.note+round(getParameterValue(PARAMETER_C)*24)-12));
+    osc.setFrequency(voltsOut.noteToHertz(allocator.getNote()+round(getParameterValue(PARAMETER_C)*24)-12));
     osc.getSamples(fm);
     fm.multiply(getParameterValue(PARAMETER_D)*0.2);
     left.add(fm);
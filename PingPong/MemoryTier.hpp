@@ -0,0 +1,308 @@
+#ifndef __MemoryTier_hpp__
+#define __MemoryTier_hpp__
+
+#include <new>
+#include "FloatArray.h"
+
+#define ARENA_ALIGNMENT 32 // a Cortex-M7 cache line, and wide enough for SIMD loads
+#ifndef FAST_MEMORY_SIZE
+#define FAST_MEMORY_SIZE (256*1024) // most a patch reserves for its fast region
+#endif
+#define MEMORY_HEADROOM  (4*1024) // added to each region, for objects and alignment
+
+enum MemoryTier {
+  HOT_MEMORY,  // small buffers used every block, such as reverb nodes
+  BULK_MEMORY, // long delay lines
+  MEMORY_TIERS
+};
+
+/* where an allocation ended up: one of the two regions, or the heap */
+enum MemoryLocation {
+  FAST_LOCATION,
+  BULK_LOCATION,
+  HEAP_LOCATION,
+  MEMORY_LOCATIONS,
+  MEMORY_REGIONS = HEAP_LOCATION
+};
+
+#ifdef MEMORY_TIER_ACCOUNTING
+#define MEMORY_ACCESS(ptr, bytes) MemoryTiers::get().access(ptr, bytes)
+#else
+#define MEMORY_ACCESS(ptr, bytes)
+#endif
+
+/**
+ * Bump allocator over one block of memory. Every allocation is aligned
+ * to ARENA_ALIGNMENT, and nothing is freed on its own: reset() releases
+ * everything at once, so the arena does not fragment.
+ */
+class MemoryArena {
+private:
+  uint8_t* base;
+  size_t size;
+  size_t used;
+public:
+  MemoryArena() : base(NULL), size(0), used(0) {}
+  MemoryArena(void* ptr, size_t bytes) : base((uint8_t*)ptr), size(bytes), used(0) {
+    // align the start, so that offsets keep the alignment
+    size_t skip = -(uintptr_t)base & (ARENA_ALIGNMENT-1);
+    base += min(skip, size);
+    size -= min(skip, size);
+  }
+  void* allocate(size_t bytes){
+    size_t offset = (used + ARENA_ALIGNMENT-1) & ~(size_t)(ARENA_ALIGNMENT-1);
+    if(offset + bytes > size)
+      return NULL;
+    used = offset + bytes;
+    return base + offset;
+  }
+  bool contains(void* ptr){
+    return (uint8_t*)ptr >= base && (uint8_t*)ptr < base + size;
+  }
+  void reset(){
+    used = 0;
+  }
+  size_t getUsed(){
+    return used;
+  }
+  size_t getSize(){
+    return size;
+  }
+};
+
+/**
+ * Places patch buffers by how often they are used. There is a fast and a
+ * bulk region, each allocated from the bottom up: hot buffers go to the
+ * fast region first and overflow to the bulk region, bulk buffers go to
+ * the bulk region. Anything that does not fit, or that has no region set,
+ * comes from the heap, aligned the same way. Each region is a
+ * MemoryArena, released only as a whole, by reset(); destroying a buffer
+ * only frees heap memory. Objects are placed in the tiers with create().
+ *
+ * Each patch reserves its regions from the heap as it is constructed,
+ * with a MemoryRegions member. The heap fills internal SRAM before the
+ * external SDRAM, so the fast region, reserved first, lands in SRAM when
+ * it fits. HostBench sets up both regions itself before it constructs a
+ * patch, to simulate SRAM of a given size, and the patch leaves them be.
+ * Either way the regions are reset when the patch is destroyed, so the
+ * next patch loaded starts with them empty.
+ *
+ * With MEMORY_TIER_ACCOUNTING defined, the sample storage also counts
+ * the bytes it reads and writes in each location, which getAccessCost()
+ * weighs by a cost per byte, to simulate the tiers on the host.
+ */
+class MemoryTiers {
+private:
+  MemoryArena arenas[MEMORY_REGIONS];
+  uint8_t* reserved[MEMORY_REGIONS];
+  size_t allocated[MEMORY_LOCATIONS];
+  uint64_t accessed[MEMORY_LOCATIONS];
+  float cost[MEMORY_LOCATIONS];
+
+  void* allocate(MemoryLocation location, size_t bytes){
+    void* ptr = arenas[location].allocate(bytes);
+    if(ptr != NULL)
+      allocated[location] += bytes;
+    return ptr;
+  }
+
+  /* allocate from the heap, aligned, with the block to free just before it */
+  void* allocateHeap(size_t bytes){
+    uint8_t* block = new uint8_t[bytes + sizeof(uint8_t*) + ARENA_ALIGNMENT-1];
+    uintptr_t start = (uintptr_t)(block + sizeof(uint8_t*));
+    uint8_t** ptr = (uint8_t**)((start + ARENA_ALIGNMENT-1) & ~(uintptr_t)(ARENA_ALIGNMENT-1));
+    ptr[-1] = block;
+    allocated[HEAP_LOCATION] += bytes;
+    return ptr;
+  }
+public:
+  MemoryTiers(){
+    for(int i=0; i<MEMORY_REGIONS; i++)
+      reserved[i] = NULL;
+    for(int i=0; i<MEMORY_LOCATIONS; i++)
+      cost[i] = i == FAST_LOCATION ? 1 : 4;
+    reset();
+    resetAccessed();
+  }
+
+  /**
+   * use @param bytes of memory at @param ptr as the @param region
+   */
+  void setRegion(MemoryLocation region, void* ptr, size_t bytes){
+    release(region);
+    arenas[region] = MemoryArena(ptr, bytes);
+  }
+
+  /**
+   * take @param bytes from the heap for the @param region, in one
+   * allocation. Returns false, leaving the region unset, if the heap
+   * is short of memory.
+   */
+  bool reserve(MemoryLocation region, size_t bytes){
+    uint8_t* ptr = new (std::nothrow) uint8_t[bytes];
+    if(ptr == NULL)
+      return false;
+    setRegion(region, ptr, bytes);
+    reserved[region] = ptr;
+    return true;
+  }
+
+  bool hasRegion(MemoryLocation region){
+    return arenas[region].getSize() > 0;
+  }
+
+  /* give a reserved region back to the heap */
+  void release(MemoryLocation region){
+    delete[] reserved[region];
+    reserved[region] = NULL;
+    arenas[region] = MemoryArena();
+  }
+
+  /**
+   * set the relative cost of accessing a byte in @param location
+   */
+  void setCost(MemoryLocation location, float value){
+    cost[location] = value;
+  }
+
+  /**
+   * release all region memory at once and clear the bytes allocated.
+   * MemoryRegions calls this when the patch is destroyed.
+   */
+  void reset(){
+    for(int i=0; i<MEMORY_REGIONS; i++)
+      arenas[i].reset();
+    for(int i=0; i<MEMORY_LOCATIONS; i++)
+      allocated[i] = 0;
+  }
+
+  /* clear the bytes accessed, which outlive the patch that made them */
+  void resetAccessed(){
+    for(int i=0; i<MEMORY_LOCATIONS; i++)
+      accessed[i] = 0;
+  }
+
+  void* allocate(size_t bytes, MemoryTier tier){
+    void* ptr = NULL;
+    if(tier == HOT_MEMORY)
+      ptr = allocate(FAST_LOCATION, bytes);
+    if(ptr == NULL)
+      ptr = allocate(BULK_LOCATION, bytes);
+    if(ptr == NULL)
+      ptr = allocateHeap(bytes);
+    return ptr;
+  }
+
+  MemoryLocation locate(void* ptr){
+    for(int i=0; i<MEMORY_REGIONS; i++)
+      if(arenas[i].contains(ptr))
+	return (MemoryLocation)i;
+    return HEAP_LOCATION;
+  }
+
+  void free(void* ptr){
+    if(ptr != NULL && locate(ptr) == HEAP_LOCATION)
+      delete[] ((uint8_t**)ptr)[-1];
+  }
+
+  FloatArray createFloatArray(size_t samples, MemoryTier tier){
+    FloatArray array((float*)allocate(samples*sizeof(float), tier), samples);
+    array.clear();
+    return array;
+  }
+
+  void destroy(FloatArray array){
+    free(array.getData());
+  }
+
+  /**
+   * construct an object of class T in @param tier, with @param args
+   */
+  template<class T, typename... Args>
+  T* create(MemoryTier tier, Args... args){
+    return new (allocate(sizeof(T), tier)) T(args...);
+  }
+
+  template<class T>
+  void destroy(T* object){
+    object->~T();
+    free(object);
+  }
+
+  void access(void* ptr, size_t bytes){
+    accessed[locate(ptr)] += bytes;
+  }
+
+  /**
+   * get the bytes allocated in @param location
+   */
+  size_t getAllocated(MemoryLocation location){
+    return allocated[location];
+  }
+
+  /**
+   * get the bytes read and written in @param location since resetAccessed()
+   */
+  uint64_t getAccessed(MemoryLocation location){
+    return accessed[location];
+  }
+
+  /**
+   * get the weighted cost of all accesses since resetAccessed()
+   */
+  double getAccessCost(){
+    double total = 0;
+    for(int i=0; i<MEMORY_LOCATIONS; i++)
+      total += accessed[i]*cost[i];
+    return total;
+  }
+
+  /* show the kilobytes allocated in each location, rounded up */
+  void report(){
+    debugMessage("fast/bulk/heap kB", (int)((allocated[FAST_LOCATION]+1023)/1024),
+		 (int)((allocated[BULK_LOCATION]+1023)/1024), (int)((allocated[HEAP_LOCATION]+1023)/1024));
+  }
+
+  static MemoryTiers& get(){
+    static MemoryTiers tiers;
+    return tiers;
+  }
+};
+
+/**
+ * Reserves the regions a patch places its buffers in, for as long as the
+ * patch lives. Declare it as the first member of the patch, so that it
+ * is constructed before any buffer is placed and destroyed after the
+ * last one is. Regions the host has already set up are kept, and reset
+ * for the next patch.
+ */
+class MemoryRegions {
+private:
+  bool reserved[MEMORY_REGIONS];
+public:
+  /**
+   * reserve room for @param hot and @param bulk bytes of buffers. The fast
+   * region holds at most FAST_MEMORY_SIZE. If the hot buffers do not all
+   * fit in it, the bulk region has room for all of them, as the buffers
+   * that overflow need not be the last ones.
+   */
+  MemoryRegions(size_t hot, size_t bulk){
+    MemoryTiers& tiers = MemoryTiers::get();
+    hot += MEMORY_HEADROOM;
+    bulk += MEMORY_HEADROOM;
+    size_t fast = min(hot, (size_t)FAST_MEMORY_SIZE);
+    reserved[FAST_LOCATION] = !tiers.hasRegion(FAST_LOCATION) && tiers.reserve(FAST_LOCATION, fast);
+    if(fast < hot || !tiers.hasRegion(FAST_LOCATION))
+      bulk += hot;
+    reserved[BULK_LOCATION] = !tiers.hasRegion(BULK_LOCATION) && tiers.reserve(BULK_LOCATION, bulk);
+  }
+
+  ~MemoryRegions(){
+    MemoryTiers::get().reset();
+    for(int i=0; i<MEMORY_REGIONS; i++)
+      if(reserved[i])
+	MemoryTiers::get().release((MemoryLocation)i);
+  }
+};
+
+#endif // __MemoryTier_hpp__
@@ -0,0 +1,124 @@
+#ifndef __MultiTapDelay_hpp__
+#define __MultiTapDelay_hpp__
+
+#include "CrossFadeBuffer.hpp"
+
+#define MAX_TAPS 16
+
+/**
+ * Mono in, stereo out delay with up to MAX_TAPS taps on a single delay
+ * line. Each tap has a delay, a gain and a pan position. Taps are read a
+ * block at a time, crossfading when their delay changes, and gains are
+ * ramped over the block, so all parameters can change every block.
+ * Taps that are removed fade out over the next block.
+ *
+ * Delays are at least one block long, which lets the line be read before
+ * the input block is written, with feedback from the last tap.
+ */
+class MultiTapDelay {
+private:
+  CrossFadeBuffer* buffer;
+  FloatArray tap;
+  int count;
+  int active; // taps read in the last block
+  int delays[MAX_TAPS];
+  int previousDelays[MAX_TAPS];
+  float gainsL[MAX_TAPS];
+  float gainsR[MAX_TAPS];
+  float previousGainsL[MAX_TAPS];
+  float previousGainsR[MAX_TAPS];
+
+  /* add @param source to @param destination with a gain ramp */
+  static void add(float* source, float* destination, float from, float to, size_t len){
+    float step = (to - from)/len;
+    for(size_t i=0; i<len; i++)
+      destination[i] += source[i]*(from + step*i);
+  }
+
+  /**
+   * read tap @param index into the scratch block and add it to the
+   * outputs, with the gains ramping to @param toL and @param toR
+   */
+  void read(int index, float toL, float toR, float* left, float* right, size_t len){
+    float* x = tap.getData();
+    // a delay of d samples is the block read ending d-len steps back
+    buffer->fade(previousDelays[index]-len, delays[index]-len, x, len);
+    add(x, left, previousGainsL[index], toL, len);
+    add(x, right, previousGainsR[index], toR, len);
+    previousDelays[index] = delays[index];
+    previousGainsL[index] = toL;
+    previousGainsR[index] = toR;
+  }
+public:
+  MultiTapDelay(CrossFadeBuffer* buf, FloatArray tp) : buffer(buf), tap(tp), count(0), active(0) {
+    for(int i=0; i<MAX_TAPS; i++){
+      delays[i] = previousDelays[i] = tap.getSize();
+      gainsL[i] = gainsR[i] = previousGainsL[i] = previousGainsR[i] = 0;
+    }
+  }
+
+  void setTapCount(int taps){
+    count = max(0, min(MAX_TAPS, taps));
+  }
+
+  int getTapCount(){
+    return count;
+  }
+
+  /**
+   * get the longest delay in samples
+   */
+  int getMaxDelay(){
+    return buffer->getSize() - 1;
+  }
+
+  /**
+   * set tap @param index to a delay of @param delay samples, with a @param gain
+   * and a @param pan position from 0 (left) to 1 (right), using an equal power pan law
+   */
+  void setTap(int index, int delay, float gain, float pan){
+    delays[index] = max((int)tap.getSize(), min(getMaxDelay(), delay));
+    gainsL[index] = gain*cosf(pan*M_PI/2);
+    gainsR[index] = gain*sinf(pan*M_PI/2);
+  }
+
+  /**
+   * add the taps to @param left and @param right, then write a block of
+   * @param input plus @param feedback times the last tap to the delay line
+   */
+  void process(float* input, float* left, float* right, float feedback, size_t len){
+    ASSERT(tap.getSize() == len, "Tap length must match block size");
+    float* x = tap.getData();
+    // removed taps ramp to 0, and fade in from 0 when enabled again; they
+    // are read first, so that the last tap is left in x for the feedback
+    for(int i=count; i<active; i++)
+      read(i, 0, 0, left, right, len);
+    for(int i=0; i<count; i++)
+      read(i, gainsL[i], gainsR[i], left, right, len);
+    active = count;
+    if(count == 0){
+      buffer->write(input, len);
+    }else{
+      for(size_t i=0; i<len; i++)
+	x[i] = input[i] + feedback*x[i];
+      buffer->write(x, len);
+    }
+  }
+
+  void process(FloatArray input, FloatArray left, FloatArray right, float feedback){
+    process(input, left, right, feedback, input.getSize());
+  }
+
+  static MultiTapDelay* create(int samples, int blocksize){
+    return MemoryTiers::get().create<MultiTapDelay>(HOT_MEMORY, CrossFadeBuffer::create(samples, blocksize, BULK_MEMORY),
+						    MemoryTiers::get().createFloatArray(blocksize, HOT_MEMORY));
+  }
+
+  static void destroy(MultiTapDelay* delay){
+    CrossFadeBuffer::destroy(delay->buffer);
+    MemoryTiers::get().destroy(delay->tap);
+    MemoryTiers::get().destroy(delay);
+  }
+};
+
+#endif // __MultiTapDelay_hpp__
@@ -0,0 +1,141 @@
+#ifndef __MultiTapDelayPatch_hpp__
+#define __MultiTapDelayPatch_hpp__
+
+/**
+
+AUTHOR:
+    (c) 2020 Martin Klang
+    martin@rebeltech.org
+
+LICENSE:
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+DESCRIPTION:
+    Rhythmic multi-tap delay with tap tempo. Up to 16 taps share a single
+    delay line of 5.4 seconds, spaced evenly at the product of the current
+    tempo and ratio: with a ratio of 1/4, the taps fall on sixteenth notes.
+
+    Tap button A to set the tempo. Adjust with Tempo knob. Ratio sets a
+    musical divisor or multiplier, from 1/4 to 4. Taps sets the number of
+    taps, Decay how much quieter each tap is than the one before, and
+    Spread how far the taps are panned alternately left and right.
+    Feedback repeats the pattern from the last tap.
+    The trigger output clocks out the tap spacing.
+
+*/
+
+#include "Patch.h"
+#include "DcFilter.hpp"
+#include "TapTempo.hpp"
+#include "TempoLfo.hpp"
+#include "ParameterCache.hpp"
+#include "Saturator.hpp"
+#include "TempoRatios.hpp"
+#include "MultiTapDelay.hpp"
+
+class MultiTapDelayPatch : public Patch {
+private:
+  static const int TRIGGER_LIMIT = (1<<17);
+  MemoryRegions regions;
+  MultiTapDelay* delay;
+  FloatArray mono;
+  TapTempo<TRIGGER_LIMIT> tempo;
+  TempoLfo lfo;
+  StereoDcFilter dc;
+  Saturator<PADE_SATURATOR> saturator;
+  int ratio;
+  enum { CACHE_RATIO, CACHE_PERIOD, CACHE_TAPS, CACHE_DECAY, CACHE_SPREAD, CACHE_WET, CACHE_COUNT };
+  ParameterCache<CACHE_COUNT> cache;
+public:
+  MultiTapDelayPatch() : regions(getBlockSize()*3*sizeof(float), TRIGGER_LIMIT*2*sizeof(float)),
+			 tempo(getSampleRate()*60/120), ratio(0), cache(1/2048.0) {
+    registerParameter(PARAMETER_A, "Tempo");
+    registerParameter(PARAMETER_B, "Feedback");
+    registerParameter(PARAMETER_C, "Ratio");
+    registerParameter(PARAMETER_D, "Dry/Wet");
+    registerParameter(PARAMETER_E, "Taps");
+    registerParameter(PARAMETER_AA, "Decay");
+    registerParameter(PARAMETER_AB, "Spread");
+    setParameterValue(PARAMETER_E, 0.25);
+    setParameterValue(PARAMETER_AA, 0.5);
+    setParameterValue(PARAMETER_AB, 0.5);
+    delay = MultiTapDelay::create(TRIGGER_LIMIT*2, getBlockSize());
+    mono = MemoryTiers::get().createFloatArray(getBlockSize(), HOT_MEMORY);
+    cache.setThreshold(CACHE_RATIO, 1/256.0);
+    cache.setThreshold(CACHE_PERIOD, 0);
+    MemoryTiers::get().report();
+  }
+
+  ~MultiTapDelayPatch(){
+    MultiTapDelay::destroy(delay);
+    MemoryTiers::get().destroy(mono);
+  }
+
+  void buttonChanged(PatchButtonId bid, uint16_t value, uint16_t samples){
+    if(bid == BUTTON_A)
+      tempo.trigger(value != 0, samples);
+  }
+
+  /* place the taps evenly at the tap spacing, alternately left and right */
+  void setTaps(){
+    float spacing = tempo.getPeriod()*TRIGGER_LIMIT*ratios[ratio];
+    float wet = cache[CACHE_WET];
+    float decay = cache[CACHE_DECAY];
+    float spread = cache[CACHE_SPREAD]*0.5;
+    int taps = 1 + (int)(cache[CACHE_TAPS]*(MAX_TAPS-1) + 0.5);
+    // drop taps that do not fit in the delay line
+    taps = max(1, min(taps, (int)(delay->getMaxDelay()/spacing)));
+    delay->setTapCount(taps);
+    float gain = wet;
+    for(int i=0; i<taps; i++){
+      delay->setTap(i, spacing*(i+1), gain, i & 1 ? 0.5+spread : 0.5-spread);
+      gain *= 1 - decay;
+    }
+  }
+
+  void processAudio(AudioBuffer& buffer){
+    size_t size = buffer.getSize();
+    tempo.clock(size);
+    tempo.setSpeed(getParameterValue(PARAMETER_A)*4096);
+    // not short-circuited: every slot must be updated
+    bool changed = cache.update(CACHE_RATIO, getParameterValue(PARAMETER_C)) |
+      cache.update(CACHE_PERIOD, tempo.getPeriod()) |
+      cache.update(CACHE_TAPS, getParameterValue(PARAMETER_E)) |
+      cache.update(CACHE_DECAY, getParameterValue(PARAMETER_AA)) |
+      cache.update(CACHE_SPREAD, getParameterValue(PARAMETER_AB)) |
+      cache.update(CACHE_WET, getParameterValue(PARAMETER_D));
+    if(changed){
+      ratio = min(RATIOS_COUNT-1, (int)(cache[CACHE_RATIO] * RATIOS_COUNT));
+      lfo.setRatio(ratios[ratio], counters[ratio]);
+      setTaps();
+    }
+    float feedback = getParameterValue(PARAMETER_B);
+    float dry = 1.0 - cache[CACHE_WET];
+    FloatArray left = buffer.getSamples(LEFT_CHANNEL);
+    FloatArray right = buffer.getSamples(RIGHT_CHANNEL);
+    dc.process(buffer); // remove DC offset
+    for(size_t i=0; i<size; i++)
+      mono[i] = (left[i] + right[i])*0.5f;
+    left.multiply(dry);
+    right.multiply(dry);
+    delay->process(mono, left, right, feedback);
+    saturator.process(left);
+    saturator.process(right);
+    lfo.clock(tempo);
+    setButton(PUSHBUTTON, lfo.getSquare());
+  }
+};
+
+#endif   // __MultiTapDelayPatch_hpp__
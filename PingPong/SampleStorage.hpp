@@ -0,0 +1,288 @@
+#ifndef __SampleStorage_hpp__
+#define __SampleStorage_hpp__
+
+#include "FloatArray.h"
+#include "MemoryTier.hpp"
+
+/**
+ * Sample storage for the circular buffers. Every storage type converts
+ * to and from float on access, so that buffers can trade precision for
+ * memory without changing their API.
+ *
+ * Block accesses never wrap: index + len is at most getSize().
+ * Writes must be sequential, as they are from the write head of a
+ * circular buffer. The samples are allocated from a MemoryTier.
+ */
+class FloatStorage {
+private:
+  FloatArray data;
+public:
+  FloatStorage(){}
+  FloatStorage(FloatArray buf) : data(buf) {}
+  size_t getSize(){
+    return data.getSize();
+  }
+  inline float get(unsigned int index){
+    MEMORY_ACCESS(&data[index], sizeof(float));
+    return data[index];
+  }
+  void get(unsigned int index, float* destination, size_t len){
+    MEMORY_ACCESS(&data[index], len*sizeof(float));
+    memcpy(destination, &data[index], len*sizeof(float));
+  }
+  /* add @param len samples times @param gain to @param destination */
+  void mix(unsigned int index, float gain, float* destination, size_t len){
+    MEMORY_ACCESS(&data[index], len*sizeof(float));
+    float* src = &data[index];
+    for(size_t i=0; i<len; i++)
+      destination[i] += src[i]*gain;
+  }
+  inline void set(unsigned int index, float value){
+    MEMORY_ACCESS(&data[index], sizeof(float));
+    data[index] = value;
+  }
+  void set(unsigned int index, const float* source, size_t len){
+    MEMORY_ACCESS(&data[index], len*sizeof(float));
+    memcpy(&data[index], source, len*sizeof(float));
+  }
+  void setAll(float value){
+    data.setAll(value);
+  }
+  FloatArray getSamples(){
+    return data;
+  }
+  static FloatStorage create(size_t samples, MemoryTier tier = BULK_MEMORY){
+    return FloatStorage(MemoryTiers::get().createFloatArray(samples, tier));
+  }
+  static void destroy(FloatStorage storage){
+    MemoryTiers::get().destroy(storage.data);
+  }
+};
+
+/**
+ * 16-bit fixed point storage, at half the memory of float. Samples are
+ * saturated to +/- range.
+ */
+class ShortStorage {
+private:
+  int16_t* data;
+  size_t size;
+  float scale;
+  float unscale;
+  int16_t encode(float value){
+    value = max(-32767.0f, min(32767.0f, value*scale));
+    return value + copysignf(0.5f, value); // round to nearest
+  }
+public:
+  ShortStorage() : data(NULL), size(0), scale(0), unscale(0) {}
+  ShortStorage(int16_t* buf, size_t len, float range) :
+    data(buf), size(len), scale(32767/range), unscale(range/32767) {}
+  size_t getSize(){
+    return size;
+  }
+  inline float get(unsigned int index){
+    MEMORY_ACCESS(data+index, sizeof(int16_t));
+    return data[index]*unscale;
+  }
+  void get(unsigned int index, float* destination, size_t len){
+    MEMORY_ACCESS(data+index, len*sizeof(int16_t));
+    int16_t* src = data+index;
+    for(size_t i=0; i<len; i++)
+      destination[i] = src[i]*unscale;
+  }
+  void mix(unsigned int index, float gain, float* destination, size_t len){
+    MEMORY_ACCESS(data+index, len*sizeof(int16_t));
+    int16_t* src = data+index;
+    float scale = unscale*gain;
+    for(size_t i=0; i<len; i++)
+      destination[i] += src[i]*scale;
+  }
+  inline void set(unsigned int index, float value){
+    MEMORY_ACCESS(data+index, sizeof(int16_t));
+    data[index] = encode(value);
+  }
+  void set(unsigned int index, const float* source, size_t len){
+    MEMORY_ACCESS(data+index, len*sizeof(int16_t));
+    int16_t* dest = data+index;
+    for(size_t i=0; i<len; i++)
+      dest[i] = encode(source[i]);
+  }
+  void setAll(float value){
+    int16_t x = encode(value);
+    for(size_t i=0; i<size; i++)
+      data[i] = x;
+  }
+  /* the default range leaves 6dB of headroom for feedback */
+  static ShortStorage create(size_t samples, MemoryTier tier = BULK_MEMORY, float range = 2.0f){
+    int16_t* data = (int16_t*)MemoryTiers::get().allocate(samples*sizeof(int16_t), tier);
+    ShortStorage storage(data, samples, range);
+    storage.setAll(0);
+    return storage;
+  }
+  static void destroy(ShortStorage storage){
+    MemoryTiers::get().free(storage.data);
+  }
+};
+
+/**
+ * Block floating point storage: 16-bit mantissas with one exponent per
+ * block of 32 samples, at a little more than half the memory of float.
+ * Quiet passages keep their full 16 bits of resolution.
+ *
+ * A block's exponent is set by the first samples written to it, and
+ * raised, rescaling the block, if later samples are louder. The old
+ * samples not yet overwritten in a block are the oldest in the buffer,
+ * and are kept exactly, so the whole buffer can be read back.
+ */
+class BlockFloatStorage {
+private:
+  static const int BLOCK_BITS = 5;
+  static const int BLOCK_SIZE = 1<<BLOCK_BITS;
+  static const int MIN_EXPONENT = -96;
+  static const int MAX_EXPONENT = 96;
+  int16_t* mantissas;
+  int8_t* exponents;
+  size_t size;
+  /* 2^e, built from the exponent bits */
+  static float power(int e){
+    union { uint32_t i; float f; } u;
+    u.i = (uint32_t)(127 + e) << 23;
+    return u.f;
+  }
+  /* the bits of |value|, which compare as integers in the same order */
+  static uint32_t magnitude(float value){
+    union { float f; uint32_t i; } u;
+    u.f = value;
+    return u.i & 0x7fffffff;
+  }
+  /* smallest e that a value with @param magnitude bits is less than 2^e of */
+  static int exponent(uint32_t magnitude){
+    int e = (int)(magnitude >> 23) - 126;
+    return max(MIN_EXPONENT, min(MAX_EXPONENT, e));
+  }
+  static int16_t encode(float value, float scale){
+    value = max(-32767.0f, min(32767.0f, value*scale));
+    return value + copysignf(0.5f, value); // round to nearest
+  }
+  /**
+   * set the exponent of the block at @param index to at least @param ex
+   * for writing @param len samples, rescaling the rest of the block to
+   * match, and return the scale to encode them with
+   */
+  float setExponent(unsigned int index, size_t len, int ex){
+    unsigned int offset = index & (BLOCK_SIZE-1);
+    int16_t* block = mantissas + index - offset;
+    int8_t& e = exponents[index >> BLOCK_BITS];
+    if(offset == 0){
+      if(len < BLOCK_SIZE){
+	// keep room for the old samples left in the block
+	int m = 0;
+	for(unsigned int i=len; i<BLOCK_SIZE; i++)
+	  m = max(m, abs(block[i]));
+	ex = max(ex, exponent(magnitude(m)) + e - 15);
+      }
+    }else{
+      ex = max(ex, (int)e);
+    }
+    if(ex > e){
+      int shift = min(ex - e, 16);
+      for(unsigned int i=0; i<BLOCK_SIZE; i++)
+	block[i] >>= shift;
+    }else if(ex < e && len < BLOCK_SIZE){
+      int scale = 1 << min(e - ex, 16); // the old samples still fit
+      for(unsigned int i=0; i<BLOCK_SIZE; i++)
+	block[i] *= scale;
+    }
+    e = ex;
+    return power(15 - e);
+  }
+public:
+  BlockFloatStorage() : mantissas(NULL), exponents(NULL), size(0) {}
+  BlockFloatStorage(int16_t* buf, int8_t* exp, size_t len) :
+    mantissas(buf), exponents(exp), size(len) {
+    ASSERT((len & (BLOCK_SIZE-1)) == 0, "BlockFloatStorage size must be a multiple of 32");
+  }
+  size_t getSize(){
+    return size;
+  }
+  inline float get(unsigned int index){
+    MEMORY_ACCESS(mantissas+index, sizeof(int16_t));
+    return mantissas[index]*power(exponents[index >> BLOCK_BITS] - 15);
+  }
+  void get(unsigned int index, float* destination, size_t len){
+    MEMORY_ACCESS(mantissas+index, len*sizeof(int16_t));
+    while(len){
+      size_t n = min(len, (size_t)(BLOCK_SIZE - (index & (BLOCK_SIZE-1))));
+      float unscale = power(exponents[index >> BLOCK_BITS] - 15);
+      int16_t* src = mantissas+index;
+      for(size_t i=0; i<n; i++)
+	destination[i] = src[i]*unscale;
+      destination += n;
+      index += n;
+      len -= n;
+    }
+  }
+  void mix(unsigned int index, float gain, float* destination, size_t len){
+    MEMORY_ACCESS(mantissas+index, len*sizeof(int16_t));
+    while(len){
+      size_t n = min(len, (size_t)(BLOCK_SIZE - (index & (BLOCK_SIZE-1))));
+      float scale = power(exponents[index >> BLOCK_BITS] - 15)*gain;
+      int16_t* src = mantissas+index;
+      for(size_t i=0; i<n; i++)
+	destination[i] += src[i]*scale;
+      destination += n;
+      index += n;
+      len -= n;
+    }
+  }
+  inline void set(unsigned int index, float value){
+    MEMORY_ACCESS(mantissas+index, sizeof(int16_t));
+    int ex = exponent(magnitude(value));
+    int e = exponents[index >> BLOCK_BITS];
+    float scale;
+    if((index & (BLOCK_SIZE-1)) == 0 || ex > e)
+      scale = setExponent(index, 1, ex);
+    else
+      scale = power(15 - e);
+    mantissas[index] = encode(value, scale);
+  }
+  void set(unsigned int index, const float* source, size_t len){
+    MEMORY_ACCESS(mantissas+index, len*sizeof(int16_t));
+    while(len){
+      unsigned int offset = index & (BLOCK_SIZE-1);
+      size_t n = min(len, (size_t)(BLOCK_SIZE - offset));
+      uint32_t peak = 0;
+      for(size_t i=0; i<n; i++)
+	peak = max(peak, magnitude(source[i]));
+      float scale = setExponent(index, n, exponent(peak));
+      int16_t* dest = mantissas+index;
+      for(size_t i=0; i<n; i++)
+	dest[i] = encode(source[i], scale);
+      source += n;
+      index += n;
+      len -= n;
+    }
+  }
+  void setAll(float value){
+    int e = exponent(magnitude(value));
+    int16_t x = encode(value, power(15 - e));
+    for(size_t i=0; i<size; i++)
+      mantissas[i] = x;
+    for(size_t i=0; i<(size >> BLOCK_BITS); i++)
+      exponents[i] = e;
+  }
+  static BlockFloatStorage create(size_t samples, MemoryTier tier = BULK_MEMORY){
+    MemoryTiers& tiers = MemoryTiers::get();
+    int16_t* mantissas = (int16_t*)tiers.allocate(samples*sizeof(int16_t), tier);
+    int8_t* exponents = (int8_t*)tiers.allocate(samples >> BLOCK_BITS, HOT_MEMORY);
+    BlockFloatStorage storage(mantissas, exponents, samples);
+    storage.setAll(0);
+    return storage;
+  }
+  static void destroy(BlockFloatStorage storage){
+    MemoryTiers::get().free(storage.mantissas);
+    MemoryTiers::get().free(storage.exponents);
+  }
+};
+
+#endif // __SampleStorage_hpp__
@@ -0,0 +1,103 @@
+#ifndef __Saturator_hpp__
+#define __Saturator_hpp__
+
+#include "FloatArray.h"
+
+enum SaturatorMode {
+  PADE_SATURATOR,  // 7/6 rational approximation of tanh, max error 9.6e-5
+  CUBIC_SATURATOR, // clamped cubic soft clipper, cheapest, not a close tanh fit
+  TABLE_SATURATOR  // linearly interpolated tanh table, max error 9.1e-5
+};
+
+/**
+ * Soft saturation with a tanh-like curve, in place of a tanhf() call per
+ * sample. All modes are odd, have unit slope at zero and saturate at +/-1.
+ *
+ * The block methods are plain loops without calls or branches, so that
+ * compilers can vectorise them where the target has float SIMD.
+ */
+template<SaturatorMode mode>
+class Saturator {
+private:
+  static const int TABLE_SIZE = 512;
+  static const int TABLE_RANGE = 5;
+  float* table;
+
+  static float pade(float x){
+    x = max(-4.97f, min(4.97f, x)); // the approximation reaches +/-1 here
+    float x2 = x*x;
+    return x*(135135.0f + x2*(17325.0f + x2*(378.0f + x2)))/
+      (135135.0f + x2*(62370.0f + x2*(3150.0f + x2*28.0f)));
+  }
+  static float cubic(float x){
+    x = max(-1.5f, min(1.5f, x));
+    return x - (4.0f/27.0f)*x*x*x;
+  }
+  float lookup(float x){
+    float index = (max(-TABLE_RANGE, min(TABLE_RANGE, x)) + TABLE_RANGE)*(TABLE_SIZE/(2.0f*TABLE_RANGE));
+    int idx = min((int)index, TABLE_SIZE-1);
+    float frac = index - idx;
+    return table[idx]*(1.0f-frac) + table[idx+1]*frac;
+  }
+public:
+  Saturator() : table(NULL) {
+    if(mode == TABLE_SATURATOR){
+      table = new float[TABLE_SIZE+1];
+      for(int i=0; i<=TABLE_SIZE; i++)
+	table[i] = tanhf(i*(2.0f*TABLE_RANGE/TABLE_SIZE) - TABLE_RANGE);
+    }
+  }
+  ~Saturator(){
+    delete[] table;
+  }
+
+  /* process a single sample and return the result */
+  float process(float x){
+    switch(mode){
+    case PADE_SATURATOR:
+      return pade(x);
+    case CUBIC_SATURATOR:
+      return cubic(x);
+    case TABLE_SATURATOR:
+      return lookup(x);
+    }
+    return x;
+  }
+
+  void process(float* input, float* output, size_t size){
+    switch(mode){
+    case PADE_SATURATOR:
+      for(size_t i=0; i<size; i++)
+	output[i] = pade(input[i]);
+      break;
+    case CUBIC_SATURATOR:
+      for(size_t i=0; i<size; i++)
+	output[i] = cubic(input[i]);
+      break;
+    case TABLE_SATURATOR:
+      for(size_t i=0; i<size; i++)
+	output[i] = lookup(input[i]);
+      break;
+    }
+  }
+
+  /* perform in-place processing */
+  void process(FloatArray buf){
+    process(buf, buf, buf.getSize());
+  }
+
+  void process(FloatArray in, FloatArray out){
+    ASSERT(out.getSize() >= in.getSize(), "output array must be at least as long as input");
+    process(in, out, in.getSize());
+  }
+
+  static Saturator<mode>* create(){
+    return new Saturator<mode>();
+  }
+
+  static void destroy(Saturator<mode>* saturator){
+    delete saturator;
+  }
+};
+
+#endif // __Saturator_hpp__
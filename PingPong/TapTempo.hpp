@@ -2,44 +2,120 @@
 #define __TapTempo_hpp__
 
 // #define TAP_THRESHOLD     64// 256 // 78Hz at 20kHz sampling rate, or 16th notes at 293BPM
+#define TAP_HISTORY 5          // number of intervals the tempo is the median of
+#define TAP_DEADBAND 8         // ignore tempo changes below 1/2^8 of the period
 
+/**
+ * Tap tempo with sample accurate taps. The tempo is the median of the
+ * last TAP_HISTORY intervals: a single interval far off the current
+ * tempo is rejected as an outlier, and a tempo change needs two intervals
+ * in a row that agree with each other. A rejected tap is otherwise
+ * ignored: the next interval is measured from the last tap accepted.
+ * Changes smaller than the deadband are ignored, so that clock jitter
+ * does not move the tempo.
+ *
+ * A phase accumulator runs at the current tempo, and is pulled gradually
+ * towards the taps, so that LFOs can follow it without being reset.
+ */
 template<int TRIGGER_LIMIT>
 class TapTempo {
 private:
   uint32_t limit;
-  uint32_t trig;
+  int32_t trig;
   uint16_t speed;
   bool ison;
+  uint32_t intervals[TAP_HISTORY];
+  int taps;
+  uint32_t outlier;
+  float phase;
+  float correction;
+  uint32_t beats;
+
+  uint32_t median(){
+    uint32_t sorted[TAP_HISTORY];
+    for(int i=0; i<taps; i++){
+      int j = i;
+      for(; j>0 && sorted[j-1] > intervals[i]; j--)
+	sorted[j] = sorted[j-1];
+      sorted[j] = intervals[i];
+    }
+    return sorted[taps/2];
+  }
+  /**
+   * add the @param interval since the last tap accepted, and return
+   * false if it is rejected as an outlier
+   */
+  bool addInterval(uint32_t interval){
+    uint32_t since = interval - outlier; // since the rejected tap, if any
+    if(outlier != 0 && interval > outlier && since <= outlier*5/4 && since >= outlier*4/5){
+      taps = 0; // two intervals in a row agree on a new tempo
+      intervals[taps++] = outlier;
+      interval = since;
+    }else if(taps > 0 && (interval > limit*3/2 || interval < limit*2/3)){
+      outlier = interval; // reject, unless the next interval agrees
+      return false;
+    }
+    outlier = 0;
+    if(taps == TAP_HISTORY)
+      memmove(intervals, intervals+1, (TAP_HISTORY-1)*sizeof(uint32_t));
+    else
+      taps++;
+    intervals[taps-1] = interval;
+    uint32_t value = median();
+    if(abs((int32_t)(value - limit)) > (int32_t)(limit >> TAP_DEADBAND))
+      limit = value;
+    return true;
+  }
 public:
-  TapTempo(uint32_t tempo) : 
-    limit(tempo), trig(TRIGGER_LIMIT), 
-    speed(2048), ison(false) {}
+  TapTempo(uint32_t tempo) :
+    limit(tempo), trig(TRIGGER_LIMIT),
+    speed(2048), ison(false), taps(0), outlier(0),
+    phase(0), correction(0), beats(0) {}
   void trigger(bool on){
     trigger(on, 0);
   }
   bool isOn(){
     return ison;
   }
+  /**
+   * register a tap that happened @param delay samples into the block that
+   * is clocked next
+   */
   void trigger(bool on, int delay){
     // if(trig < TAP_THRESHOLD)
     //   return;
     if(on && !ison){
+      bool accepted = true;
       if(trig < TRIGGER_LIMIT){
-	limit = trig + delay;
+	accepted = addInterval(trig + delay);
+      }else{
+	taps = 0; // start a new series after a pause
+	outlier = 0;
+      }
+      if(accepted){
+	// a rejected tap leaves the count and the phase as they are
+	trig = -delay;
+	if(limit){
+	  // the phase should be 0 at the tap: correct it over the coming beat
+	  float error = phase + (float)delay/limit;
+	  error -= (int)(error + 0.5f);
+	  correction = -error;
+	}
       }
-      trig = 0;
 //      debugMessage("limit/delay", (int)limit, (int)delay);
     }
     ison = on;
   }
   void setLimit(uint32_t value){
     limit = value;
+    taps = 0;
   }
   void setSpeed(int16_t s){
     if(abs(speed-s) > 16){
       int64_t delta = (int64_t)limit*(speed-s)/2048;
       limit = max(1, limit+delta);
       speed = s;
+      taps = 0;
     }
   }
   float getPeriod(){
@@ -48,14 +124,43 @@ public:
   float getFrequency(){
     return TRIGGER_LIMIT/float(limit);
   }
+  /**
+   * get the position within the current beat, from 0 to 1
+   */
+  float getPhase(){
+    return phase;
+  }
+  /**
+   * get the number of beats counted since the start
+   */
+  uint32_t getBeats(){
+    return beats;
+  }
   void clock(){
-    if(trig < TRIGGER_LIMIT)
-      trig++;
+    clock(1);
   }
   void clock(uint32_t steps){
     trig += steps;
     if(trig > TRIGGER_LIMIT)
       trig = TRIGGER_LIMIT;
+    if(limit){
+      float step = (float)steps/limit;
+      float adjust = correction*min(1.0f, 4*step); // over a quarter beat
+      correction -= adjust;
+      phase += step + adjust;
+      while(phase >= 1){
+	phase -= 1;
+	beats++;
+      }
+      while(phase < 0){
+	if(beats == 0){
+	  phase = 0; // a correction back past the first beat
+	  break;
+	}
+	phase += 1;
+	beats--;
+      }
+    }
   }
 };
 
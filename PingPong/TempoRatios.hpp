@@ -0,0 +1,28 @@
+#ifndef __TempoRatios_hpp__
+#define __TempoRatios_hpp__
+
+/* musical divisors and multipliers of the tempo, and the number of beats
+   after which each ratio is back in phase with the tempo: the numerator
+   of the ratio, so that counter/ratio is a whole number of cycles */
+static const int RATIOS_COUNT = 9;
+static const float ratios[RATIOS_COUNT] = { 1.0/4, 
+					    1.0/3, 
+					    1.0/2, 
+					    3.0/4, 
+					    1.0, 
+					    3.0/2, 
+					    2.0,
+					    3.0, 
+					    4.0 };
+
+static const uint32_t counters[RATIOS_COUNT] = { 1, 
+						 1, 
+						 1, 
+						 3, 
+						 1, 
+						 3, 
+						 2,
+						 3, 
+						 4 };
+
+#endif // __TempoRatios_hpp__
@@ -40,70 +40,68 @@ DESCRIPTION:
 #include "Patch.h"
 #include "DcFilter.hpp"
 #include "BiquadFilter.h"
-#include "CircularBuffer.hpp"
+#include "CrossFadeBuffer.hpp"
 #include "TapTempo.hpp"
-#include "SineOscillator.h"
-#include "RampOscillator.h"
+#include "TempoLfo.hpp"
 #include "SmoothValue.h"
+#include "ParameterCache.hpp"
+#include "Saturator.hpp"
+#include "TempoRatios.hpp"
 
-static const int RATIOS_COUNT = 9;
-static const float ratios[RATIOS_COUNT] = { 1.0/4, 
-					    1.0/3, 
-					    1.0/2, 
-					    3.0/4, 
-					    1.0, 
-					    3.0/2, 
-					    2.0,
-					    3.0, 
-					    4.0 };
+// #define USE_COMPACT_DELAY
 
-static const uint32_t counters[RATIOS_COUNT] = { 1, 
-						 1, 
-						 1, 
-						 1, 
-						 1, 
-						 3, 
-						 2,
-						 3, 
-						 4 };
+#ifdef USE_COMPACT_DELAY
+typedef CrossFadeBlockFloatBuffer DelayBuffer; // half the memory of float
+#else
+typedef CrossFadeBuffer DelayBuffer;
+#endif
 
 class TempoSyncedPingPongDelayPatch : public Patch {
 private:
   static const int TRIGGER_LIMIT = (1<<17);
-  CircularBuffer* delayBufferL;
-  CircularBuffer* delayBufferR;
+  MemoryRegions regions;
+  DelayBuffer* delayBufferL;
+  DelayBuffer* delayBufferR;
+  FloatArray delayedL, delayedR;
   int delayL, delayR, ratio;
   TapTempo<TRIGGER_LIMIT> tempo;
   StereoDcFilter dc;
   StereoBiquadFilter* lowpass;
-  RampOscillator* lfo1;
-  SineOscillator* lfo2;
+  Saturator<PADE_SATURATOR> saturator;
+  TempoLfo lfo;
   SmoothFloat time;
   SmoothFloat drop;
   SmoothFloat feedback;
+  enum { CACHE_RATIO, CACHE_PERIOD, CACHE_COUNT };
+  ParameterCache<CACHE_COUNT> cache;
+  float target;
 public:
   TempoSyncedPingPongDelayPatch() : 
-    delayL(0), delayR(0), tempo(getSampleRate()*60/120) {
+    regions(32*1024, TRIGGER_LIMIT*3*sizeof(float)), // blocks, ramps and exponents; the delay lines
+    delayL(0), delayR(0), ratio(0), tempo(getSampleRate()*60/120), target(0) {
     registerParameter(PARAMETER_A, "Tempo");
     registerParameter(PARAMETER_B, "Feedback");
     registerParameter(PARAMETER_C, "Ratio");
     registerParameter(PARAMETER_D, "Dry/Wet");
     registerParameter(PARAMETER_F, "LFO Sine>");
     registerParameter(PARAMETER_G, "LFO Ramp>");
-    delayBufferL = CircularBuffer::create(TRIGGER_LIMIT);
-    delayBufferR = CircularBuffer::create(TRIGGER_LIMIT*2);
+    delayedL = MemoryTiers::get().createFloatArray(getBlockSize(), HOT_MEMORY);
+    delayedR = MemoryTiers::get().createFloatArray(getBlockSize(), HOT_MEMORY);
+    delayBufferL = DelayBuffer::create(TRIGGER_LIMIT, getBlockSize(), BULK_MEMORY);
+    delayBufferR = DelayBuffer::create(TRIGGER_LIMIT*2, getBlockSize(), BULK_MEMORY);
     lowpass = StereoBiquadFilter::create(1);
     lowpass->setLowPass(18000/(getSampleRate()/2), FilterStage::BUTTERWORTH_Q);
-    lfo1 = RampOscillator::create(getSampleRate()/getBlockSize());    
-    lfo2 = SineOscillator::create(getSampleRate()/getBlockSize());    
+    // a wider band on the ratio knob stops it flipping between two ratios
+    cache.setThreshold(CACHE_RATIO, 1/256.0);
+    MemoryTiers::get().report();
   }
 
   ~TempoSyncedPingPongDelayPatch(){
-    CircularBuffer::destroy(delayBufferL);
-    CircularBuffer::destroy(delayBufferR);
+    DelayBuffer::destroy(delayBufferL);
+    DelayBuffer::destroy(delayBufferR);
+    MemoryTiers::get().destroy(delayedL);
+    MemoryTiers::get().destroy(delayedR);
     StereoBiquadFilter::destroy(lowpass);
-    RampOscillator::destroy(lfo1);
-    SineOscillator::destroy(lfo2);
   }
 
   float delayTime(int ratio){
@@ -114,18 +112,63 @@ public:
 
   void buttonChanged(PatchButtonId bid, uint16_t value, uint16_t samples){
     bool set = value != 0;
-    static uint32_t counter = 0;
     switch(bid){
     case BUTTON_A:
       tempo.trigger(set, samples);
-      if(set && ++counter >= counters[ratio]){
-	lfo1->reset();
-	counter = 0;
-      }
       break;
     }
   }
   
+  /**
+   * process a block when all delays are at least a block long: the
+   * feedback written in this block is not read until the next one, so the
+   * delay lines can be read and written a block at a time
+   */
+  void processBlock(FloatArray left, FloatArray right, int newDelayL, int newDelayR, float wet, float dry){
+    size_t size = left.getSize();
+    float fb = feedback;
+    float dr = drop;
+    // a delay of d samples is the block read ending d-size steps back
+    delayBufferL->fade(delayL-size, newDelayL-size, delayedL, size);
+    delayBufferR->fade(delayR-size, newDelayR-size, delayedR, size);
+    StereoDcFilter filter = dc; // a local copy keeps the state in registers
+    for(size_t n=0; n<size; n++){
+      float l = left[n];
+      float r = right[n];
+      filter.process(l, r); // remove DC offset
+      float ldly = delayedL[n];
+      float rdly = delayedR[n];
+      // replace the delayed samples with the feedback to write
+      delayedL[n] = fb*ldly + dr*l;
+      delayedR[n] = fb*rdly + dr*r;
+      left[n] = ldly*wet + l*dry;
+      right[n] = rdly*wet + r*dry;
+    }
+    dc = filter;
+    // ping pong
+    delayBufferR->write(delayedL, size);
+    delayBufferL->write(delayedR, size);
+  }
+
+  /* process a block one sample at a time, for delays shorter than a block */
+  void processSamples(FloatArray left, FloatArray right, int newDelayL, int newDelayR, float wet, float dry){
+    size_t size = left.getSize();
+    for(size_t n=0; n<size; n++){
+      float l = left[n];
+      float r = right[n];
+      dc.process(l, r); // remove DC offset
+      float x1 = n/(float)size;
+      float x0 = 1.0-x1;
+      float ldly = delayBufferL->read(delayL)*x0 + delayBufferL->read(newDelayL)*x1;
+      float rdly = delayBufferR->read(delayR)*x0 + delayBufferR->read(newDelayR)*x1;
+      // ping pong
+      delayBufferR->write(feedback*ldly + drop*l);
+      delayBufferL->write(feedback*rdly + drop*r);
+      left[n] = ldly*wet + l*dry;
+      right[n] = rdly*wet + r*dry;
+    }
+  }
+
   void processAudio(AudioBuffer& buffer){
     int speed = getParameterValue(PARAMETER_A)*4096;
     if(isButtonPressed(BUTTON_B)){
@@ -135,41 +178,38 @@ public:
       feedback = getParameterValue(PARAMETER_B);
       drop = 1.0;
     }
-    ratio = (int)(getParameterValue(PARAMETER_C) * RATIOS_COUNT);
+    bool changed = cache.update(CACHE_RATIO, getParameterValue(PARAMETER_C));
+    if(changed){
+      ratio = min(RATIOS_COUNT-1, (int)(cache[CACHE_RATIO] * RATIOS_COUNT));
+      lfo.setRatio(ratios[ratio], counters[ratio]);
+    }
     int size = buffer.getSize();
     tempo.clock(size);
     tempo.setSpeed(speed);
-    time = delayTime(ratio);
+    if(cache.update(CACHE_PERIOD, tempo.getPeriod()) || changed)
+      target = delayTime(ratio);
+    time = target;
     int newDelayL = time*(delayBufferL->getSize()-1);
     int newDelayR = time*(delayBufferR->getSize()-1);
     float wet = getParameterValue(PARAMETER_D);
     float dry = 1.0-wet;
     FloatArray left = buffer.getSamples(LEFT_CHANNEL);
     FloatArray right = buffer.getSamples(RIGHT_CHANNEL);
-    dc.process(buffer); // remove DC offset
-    for(int n=0; n<size; n++){
-      float x1 = n/(float)size;
-      float x0 = 1.0-x1;
-      float ldly = delayBufferL->read(delayL)*x0 + delayBufferL->read(newDelayL)*x1;
-      float rdly = delayBufferR->read(delayR)*x0 + delayBufferR->read(newDelayR)*x1;
-      // ping pong
-      delayBufferR->write(feedback*ldly + drop*left[n]);
-      delayBufferL->write(feedback*rdly + drop*right[n]);
-      left[n] = ldly*wet + left[n]*dry;
-      right[n] = rdly*wet + right[n]*dry;
-    }
+    // the DC offset is removed in the delay loop
+    if(min(min(delayL, newDelayL), min(delayR, newDelayR)) >= size)
+      processBlock(left, right, newDelayL, newDelayR, wet, dry);
+    else
+      processSamples(left, right, newDelayL, newDelayR, wet, dry);
     lowpass->process(buffer);
-    left.tanh();
-    right.tanh();
+    saturator.process(left);
+    saturator.process(right);
     delayL = newDelayL;
     delayR = newDelayR;
-    // Tempo synced LFO
-    float lfoFreq = getSampleRate()/(time*TRIGGER_LIMIT);
-    lfo1->setFrequency(lfoFreq);
-    lfo2->setFrequency(lfoFreq);
-    setParameterValue(PARAMETER_F, lfo1->getNextSample());
-    setParameterValue(PARAMETER_G, lfo2->getNextSample()*0.5+0.5);
-    setButton(PUSHBUTTON, lfo1->getPhase() < 0.5);
+    // Tempo synced LFO, one cycle per delay time
+    lfo.clock(tempo);
+    setParameterValue(PARAMETER_F, lfo.getSine()*0.5+0.5);
+    setParameterValue(PARAMETER_G, lfo.getRamp());
+    setButton(PUSHBUTTON, lfo.getSquare());
   }
 };
 
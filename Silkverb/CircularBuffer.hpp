@@ -1,82 +1,149 @@
 #ifndef __CircularBuffer_h__
 #define __CircularBuffer_h__
 
-class CircularBuffer {
-private:
-  FloatArray buffer;
-  unsigned int writeIndex;
+#include "SampleStorage.hpp"
+
+/**
+ * A window of samples in a circular buffer, as up to two contiguous
+ * ranges: a window that wraps around the end of the buffer continues
+ * from the start of it in the second range.
+ */
+class CircularBufferSpan {
 public:
-  CircularBuffer() : writeIndex(0) {
+  float* first;
+  size_t firstSize;
+  float* second;
+  size_t secondSize;
+  size_t getSize(){
+    return firstSize + secondSize;
   }
-  CircularBuffer(float* buf, int size) : buffer(buf, size), writeIndex(0) {
+};
+
+/**
+ * Circular buffer with a power of two capacity, so that all index
+ * arithmetic wraps with a mask. Samples are kept in a Storage from
+ * SampleStorage.hpp; spans point straight into the samples, so they are
+ * only available with FloatStorage.
+ */
+template<class Storage>
+class CircularSampleBuffer {
+protected:
+  Storage buffer;
+  unsigned int writeIndex;
+  unsigned int mask;
+  /* get the buffer index of the block read(readIndex, destination, len) returns */
+  unsigned int getReadStart(int readIndex, size_t len){
+    return (writeIndex + ~(readIndex+len)) & mask;
   }
-  CircularBuffer(FloatArray buf) : buffer(buf), writeIndex(0) {
+public:
+  CircularSampleBuffer() : writeIndex(0), mask(0) {
+  }
+  CircularSampleBuffer(Storage buf) : buffer(buf), writeIndex(0), mask(buf.getSize()-1) {
+    ASSERT((buf.getSize() & mask) == 0, "CircularBuffer size must be a power of two");
   }
 
   unsigned int getWriteIndex(){
     return writeIndex;
   }
-  
+
+  /**
+   * get the window of @param len samples starting at the write index.
+   * Fill it in and then call moveWriteHead(len) to commit the samples.
+   */
+  CircularBufferSpan getWriteSpan(size_t len){
+    return getSpan(writeIndex, len);
+  }
+
+  /**
+   * get the window of @param len samples that read(readIndex, destination, len) returns
+   */
+  CircularBufferSpan getReadSpan(int readIndex, size_t len){
+    return getSpan(writeIndex + ~(readIndex+len), len);
+  }
+
+  /**
+   * get the samples read(readIndex, destination, len) would return, if
+   * they are contiguous, or NULL: only float storage has spans
+   */
+  float* getReadWindow(int, size_t){
+    return NULL;
+  }
+
+  /**
+   * get the window getWriteSpan(len) returns, if it is contiguous, or
+   * NULL: only float storage has spans
+   */
+  float* getWriteWindow(size_t){
+    return NULL;
+  }
+
+  void moveWriteHead(size_t len){
+    writeIndex = (writeIndex + len) & mask;
+  }
+
   void write(FloatArray source){
     write(source.getData(), source.getSize());
   }
-  
+
   void write(float* source, size_t len){
-    float* ptr = &buffer[writeIndex];
-    float* end = &buffer[buffer.getSize()];
-    int cnt = len;
-    writeIndex = (writeIndex + cnt) & (buffer.getSize()-1);
-    while(ptr < end && cnt--)
-      *ptr++ = *source++;
-    ptr = &buffer[0];
-    while(cnt-- > 0)
-      *ptr++ = *source++;
-  }
-
-  /** 
-   * write to the tail of the circular buffer 
+    size_t n = min(len, getSize() - writeIndex);
+    buffer.set(writeIndex, source, n);
+    buffer.set(0, source+n, len-n);
+    moveWriteHead(len);
+  }
+
+  /**
+   * write to the tail of the circular buffer
    */
   inline void write(float value){
-    if(++writeIndex == getSize())
-      writeIndex = 0;
-    buffer[writeIndex] = value;
+    buffer.set(writeIndex, value);
+    writeIndex = (writeIndex + 1) & mask;
   }
 
   /**
    * read the value @param index steps back from the head of the circular buffer
    */
   inline float read(int index){
-    return buffer[(writeIndex-index) % buffer.getSize()];
-    // return buffer[(writeIndex + (~index)) & (buffer.getSize()-1)];
+    return buffer.get((writeIndex + (~index)) & mask);
   }
 
   void read(int readIndex, FloatArray destination){
     read(readIndex, destination.getData(), destination.getSize());
   }
 
+  /**
+   * read @param len samples, oldest first, ending @param readIndex+1 steps back from the head
+   */
   void read(int readIndex, float* destination, size_t len){
-    float* ptr = &buffer[(writeIndex + ~(readIndex+len)) & (buffer.getSize()-1)]; // start 'len' samples back
-    float* end = &buffer[buffer.getSize()];
-    int cnt = len;
-    while(ptr < end && cnt--)
-      *destination++ = *ptr++;
-    ptr = &buffer[0];
-    while(cnt-- > 0)
-      *destination++ = *ptr++;
+    unsigned int index = getReadStart(readIndex, len);
+    size_t n = min(len, getSize() - index);
+    buffer.get(index, destination, n);
+    buffer.get(0, destination+n, len-n);
+  }
+
+  /**
+   * add the samples read(readIndex, destination, len) returns, times
+   * @param gain, to @param destination
+   */
+  void mix(int readIndex, float gain, float* destination, size_t len){
+    unsigned int index = getReadStart(readIndex, len);
+    size_t n = min(len, getSize() - index);
+    buffer.mix(index, gain, destination, n);
+    buffer.mix(0, gain, destination+n, len-n);
   }
 
   /**
    * get the value at the head of the circular buffer
    */
   inline float head(){
-    return buffer[(writeIndex - 1) & (buffer.getSize()-1)];
+    return buffer.get((writeIndex - 1) & mask);
   }
 
-  /** 
-   * get the most recently written value 
+  /**
+   * get the oldest value, which is the next one to be overwritten
    */
   inline float tail(){
-    return buffer[(writeIndex) & (buffer.getSize()-1)];
+    return buffer.get(writeIndex);
   }
 
   /**
@@ -87,14 +154,14 @@ public:
   }
 
   /**
-   * return a value interpolated to a floating point index
+   * return a value linearly interpolated to a floating point index
    */
   inline float interpolate(float index){
     int idx = (int)index;
     float low = read(idx);
     float high = read(idx+1);
     float frac = index - idx;
-    return low*frac + high*(1.0-frac);
+    return low*(1.0f-frac) + high*frac;
   }
 
   void setAll(float value){
@@ -106,19 +173,46 @@ public:
   }
 
   FloatArray getSamples(){
-    return buffer;
+    return buffer.getSamples();
   }
 
-  static CircularBuffer* create(int samples){
-    CircularBuffer* buf = new CircularBuffer();
-    buf->buffer = FloatArray::create(samples);
-    return buf;
+  static CircularSampleBuffer<Storage>* create(int samples, MemoryTier tier = BULK_MEMORY){
+    return MemoryTiers::get().create<CircularSampleBuffer<Storage> >(HOT_MEMORY, Storage::create(samples, tier));
   }
 
-  static void destroy(CircularBuffer* buf){
-    FloatArray::destroy(buf->buffer);
-    delete buf;
+  static void destroy(CircularSampleBuffer<Storage>* buf){
+    Storage::destroy(buf->buffer);
+    MemoryTiers::get().destroy(buf);
+  }
+
+private:
+  CircularBufferSpan getSpan(unsigned int index, size_t len){
+    CircularBufferSpan span;
+    FloatArray samples = buffer.getSamples();
+    index &= mask;
+    MEMORY_ACCESS(&samples[index], len*sizeof(float));
+    span.first = &samples[index];
+    span.firstSize = min(len, samples.getSize() - index);
+    span.second = &samples[0];
+    span.secondSize = len - span.firstSize;
+    return span;
   }
 };
 
+template<>
+inline float* CircularSampleBuffer<FloatStorage>::getReadWindow(int readIndex, size_t len){
+  CircularBufferSpan span = getReadSpan(readIndex, len);
+  return span.secondSize == 0 ? span.first : NULL;
+}
+
+template<>
+inline float* CircularSampleBuffer<FloatStorage>::getWriteWindow(size_t len){
+  CircularBufferSpan span = getWriteSpan(len);
+  return span.secondSize == 0 ? span.first : NULL;
+}
+
+typedef CircularSampleBuffer<FloatStorage> CircularBuffer;
+typedef CircularSampleBuffer<ShortStorage> CircularShortBuffer;
+typedef CircularSampleBuffer<BlockFloatStorage> CircularBlockFloatBuffer;
+
 #endif // __CircularBuffer_h__
@@ -0,0 +1,77 @@
+#ifndef __CrossFadeBuffer_hpp__
+#define __CrossFadeBuffer_hpp__
+
+#include "CircularBuffer.hpp"
+
+/**
+ * Circular buffer that reads blocks at a delay that can change from one
+ * block to the next, crossfading linearly over the block from the old
+ * read position to the new one.
+ */
+template<class Storage>
+class CrossFadeSampleBuffer : public CircularSampleBuffer<Storage> {
+private:
+  int readIndex = 0;
+  FloatArray ramp;
+public:
+  CrossFadeSampleBuffer(){}
+  CrossFadeSampleBuffer(Storage buf, FloatArray rmp) : CircularSampleBuffer<Storage>(buf), ramp(rmp){}
+
+  void fade(int readIndex, FloatArray destination){
+    fade(readIndex, destination.getData(), destination.getSize());
+  }
+  /**
+   * read a block of @param len samples ending @param newReadIndex steps back
+   * from the head, crossfaded from the block at the previous read index.
+   * When the read index is unchanged the block is copied straight out.
+   */
+  void fade(int newReadIndex, float* destination, size_t len){
+    fade(readIndex, newReadIndex, destination, len);
+    readIndex = newReadIndex;
+  }
+  /**
+   * read a block of @param len samples, crossfaded from the block ending
+   * @param fromIndex steps back from the head to the one ending @param toIndex
+   */
+  void fade(int fromIndex, int toIndex, float* destination, size_t len){
+    if(fromIndex == toIndex){
+      this->read(toIndex, destination, len);
+    }else{
+      ASSERT(ramp.getSize() == len, "Crossfade length must match block size");
+      Storage& buffer = this->buffer;
+      unsigned int a = this->getReadStart(fromIndex, len);
+      unsigned int b = this->getReadStart(toIndex, len);
+      float* x1 = ramp.getData();
+      size_t remain = len;
+      while(remain){
+	// longest run where neither read position wraps around
+	size_t n = min(remain, buffer.getSize() - max(a, b));
+	for(size_t i=0; i<n; i++)
+	  destination[i] = buffer.get(a+i)*(1.0f-x1[i]) + buffer.get(b+i)*x1[i];
+	destination += n;
+	x1 += n;
+	remain -= n;
+	a = (a + n) & this->mask;
+	b = (b + n) & this->mask;
+      }
+    }
+  }
+  static CrossFadeSampleBuffer<Storage>* create(int samples, int blocksize, MemoryTier tier = BULK_MEMORY){
+    FloatArray ramp = MemoryTiers::get().createFloatArray(blocksize, HOT_MEMORY);
+    for(int i=0; i<blocksize; i++)
+      ramp[i] = i/(float)blocksize;
+    return MemoryTiers::get().create<CrossFadeSampleBuffer<Storage> >(HOT_MEMORY, Storage::create(samples, tier), ramp);
+  }
+
+  static void destroy(CrossFadeSampleBuffer<Storage>* buf){
+    MemoryTiers::get().destroy(buf->ramp);
+    Storage::destroy(buf->buffer);
+    MemoryTiers::get().destroy(buf);
+  }
+};
+
+typedef CrossFadeSampleBuffer<FloatStorage> CrossFadeBuffer;
+typedef CrossFadeSampleBuffer<ShortStorage> CrossFadeShortBuffer;
+typedef CrossFadeSampleBuffer<BlockFloatStorage> CrossFadeBlockFloatBuffer;
+
+#endif // __CrossFadeBuffer_hpp__
@@ -0,0 +1,110 @@
+#ifndef __EarlyReflections_hpp__
+#define __EarlyReflections_hpp__
+
+#include "CrossFadeBuffer.hpp"
+
+#define EARLY_TAPS 8
+
+/**
+ * Early reflections as sparse taps on a delay line owned by someone
+ * else, such as a pre-delay, so they take no memory of their own beyond
+ * a block of scratch. Each tap has a delay and a gain. Taps are read a
+ * block at a time and added to the output; a tap whose delay has moved
+ * since the last block is crossfaded to the new delay, and a tap whose
+ * gain has changed is ramped to the new gain over the block. From float
+ * storage, the other taps are read as spans, straight from the buffer.
+ */
+class EarlyReflections {
+private:
+  FloatArray scratch;
+  int delays[EARLY_TAPS];
+  int previousDelays[EARLY_TAPS];
+  float gains[EARLY_TAPS];
+  float previousGains[EARLY_TAPS];
+public:
+  EarlyReflections(FloatArray buf) : scratch(buf) {
+    for(int i=0; i<EARLY_TAPS; i++){
+      delays[i] = previousDelays[i] = 0;
+      gains[i] = previousGains[i] = 0;
+    }
+  }
+
+  /**
+   * set tap @param index to a block read index of @param delay, as with
+   * CircularBuffer::read(int, float*, size_t), and a gain of @param gain
+   */
+  void setTap(int index, int delay, float gain){
+    delays[index] = delay;
+    gains[index] = gain;
+  }
+
+  /**
+   * return true if the last block processed was not silent. Keep
+   * processing with all gains at 0 until it is, to fade the taps out.
+   */
+  bool isActive(){
+    for(int i=0; i<EARLY_TAPS; i++)
+      if(previousGains[i] != 0)
+	return true;
+    return false;
+  }
+
+  /**
+   * add the taps on @param buffer to @param destination
+   */
+  template<class Storage>
+  void process(CrossFadeSampleBuffer<Storage>* buffer, float* destination, size_t len){
+    ASSERT(scratch.getSize() == len, "Scratch length must match block size");
+    // taps that can be read straight from the buffer are added up to four
+    // at a time, the rest are read, crossfaded or ramped one by one
+    float* windows[EARLY_TAPS];
+    float windowGains[EARLY_TAPS];
+    int count = 0;
+    float* x = scratch.getData();
+    for(int i=0; i<EARLY_TAPS; i++){
+      if(delays[i] != previousDelays[i] || gains[i] != previousGains[i]){
+	buffer->fade(previousDelays[i], delays[i], x, len);
+	float gain = previousGains[i];
+	float step = (gains[i] - gain)/len;
+	for(size_t j=0; j<len; j++)
+	  destination[j] += x[j]*(gain + step*j);
+	previousDelays[i] = delays[i];
+	previousGains[i] = gains[i];
+      }else if((windows[count] = buffer->getReadWindow(delays[i], len)) != NULL){
+	windowGains[count++] = gains[i];
+      }else{
+	buffer->mix(delays[i], gains[i], destination, len);
+      }
+    }
+    int i = 0;
+    for(; i+4<=count; i+=4){
+      float* w0 = windows[i];
+      float* w1 = windows[i+1];
+      float* w2 = windows[i+2];
+      float* w3 = windows[i+3];
+      float g0 = windowGains[i];
+      float g1 = windowGains[i+1];
+      float g2 = windowGains[i+2];
+      float g3 = windowGains[i+3];
+      for(size_t j=0; j<len; j++)
+	destination[j] += (w0[j]*g0 + w1[j]*g1) + (w2[j]*g2 + w3[j]*g3);
+    }
+    for(; i<count; i++){
+      float* w = windows[i];
+      float g = windowGains[i];
+      for(size_t j=0; j<len; j++)
+	destination[j] += w[j]*g;
+    }
+  }
+
+  static EarlyReflections* create(int blocksize){
+    return MemoryTiers::get().create<EarlyReflections>(HOT_MEMORY, MemoryTiers::get().createFloatArray(blocksize, HOT_MEMORY));
+  }
+
+  static void destroy(EarlyReflections* early){
+    MemoryTiers::get().destroy(early->scratch);
+    MemoryTiers::get().destroy(early);
+  }
+};
+
+#endif // __EarlyReflections_hpp__
@@ -0,0 +1,180 @@
+#ifndef __FractionalDelay_hpp__
+#define __FractionalDelay_hpp__
+
+#include "CircularBuffer.hpp"
+
+enum InterpolationMode {
+  LINEAR_INTERPOLATION,  // 2 points, cheapest, lowpasses slightly at fractional positions
+  HERMITE_INTERPOLATION, // 4 points, 3rd order, flatter response up to about fs/4
+  ALLPASS_INTERPOLATION  // 1st order Thiran allpass, flat magnitude, stateful
+};
+
+/**
+ * Reads a CircularBuffer at a fractional delay. Delays are in samples,
+ * with a delay of 0 being the most recently written sample, as with
+ * CircularBuffer::read(int). Hermite interpolation needs a delay of at
+ * least 1 sample, allpass interpolation at least 0.5.
+ * Any sample storage can be read; block reads from float storage take
+ * the samples straight from the buffer where they do not wrap around.
+ *
+ * The block read methods produce the delayed version of the block that
+ * was written to the buffer last: output sample i is read at delay
+ * (delay + len - 1 - i). Write the input block first, then read.
+ *
+ * Allpass interpolation is recursive: use one FractionalDelay per tap,
+ * and read that tap continuously, or it will produce transients. It
+ * also produces a small transient when the integer part of a modulated
+ * delay changes, so it suits fixed or slowly moving delays best.
+ */
+template<InterpolationMode mode>
+class FractionalDelay {
+private:
+  float x1, y1;
+
+  static float hermite(float xm1, float x0, float x1, float x2, float frac){
+    float c = (x1 - xm1)*0.5f;
+    float v = x0 - x1;
+    float w = c + v;
+    float a = w + v + (x2 - x0)*0.5f;
+    float b = w + a;
+    return (((a*frac) - b)*frac + c)*frac + x0;
+  }
+  static int integral(float delay){
+    return mode == ALLPASS_INTERPOLATION ? (int)(delay - 0.5f) : (int)delay;
+  }
+  float allpass(float x, float frac){
+    float eta = (1 - frac)/(1 + frac);
+    float y = eta*(x - y1) + x1;
+    x1 = x;
+    y1 = y;
+    return y;
+  }
+public:
+  FractionalDelay() : x1(0), y1(0) {}
+
+  void reset(){
+    x1 = y1 = 0;
+  }
+
+  /**
+   * read a single value @param delay samples back from the head
+   */
+  template<class Storage>
+  float read(CircularSampleBuffer<Storage>* buffer, float delay){
+    int idx = integral(delay);
+    float frac = delay - idx;
+    switch(mode){
+    case LINEAR_INTERPOLATION:
+      return buffer->read(idx)*(1-frac) + buffer->read(idx+1)*frac;
+    case HERMITE_INTERPOLATION:
+      return hermite(buffer->read(idx-1), buffer->read(idx), buffer->read(idx+1), buffer->read(idx+2), frac);
+    case ALLPASS_INTERPOLATION:
+      return allpass(buffer->read(idx), frac);
+    }
+    return 0;
+  }
+
+  template<class Storage>
+  void read(CircularSampleBuffer<Storage>* buffer, float delay, FloatArray destination){
+    read(buffer, delay, destination.getData(), destination.getSize());
+  }
+
+  /**
+   * read a block of @param len samples at a fixed @param delay
+   */
+  template<class Storage>
+  void read(CircularSampleBuffer<Storage>* buffer, float delay, float* destination, size_t len){
+    int idx = integral(delay);
+    float frac = delay - idx;
+    // window from delay idx+len+1 (oldest) to idx-1 (newest)
+    float* x = buffer->getReadWindow(idx-2, len+3);
+    if(x == NULL || mode == ALLPASS_INTERPOLATION){
+      for(size_t i=0; i<len; i++)
+	destination[i] = read(buffer, delay+len-1-i);
+      return;
+    }
+    switch(mode){
+    case LINEAR_INTERPOLATION:
+      for(size_t i=0; i<len; i++)
+	destination[i] = x[i+2]*(1-frac) + x[i+1]*frac;
+      break;
+    case HERMITE_INTERPOLATION:
+      for(size_t i=0; i<len; i++)
+	destination[i] = hermite(x[i+3], x[i+2], x[i+1], x[i], frac);
+      break;
+    default:
+      break;
+    }
+  }
+
+  /**
+   * read a block of @param len samples with the delay moving linearly
+   * from @param from to @param to over the block, for smooth delay time changes
+   */
+  template<class Storage>
+  void read(CircularSampleBuffer<Storage>* buffer, float from, float to, float* destination, size_t len){
+    if(from == to)
+      return read(buffer, from, destination, len);
+    read(buffer, from, to, destination, len, [](float x){ return x; });
+  }
+
+  /**
+   * read a block with the delay moving from @param from to @param to,
+   * passing every sample through @param process, a function of one float
+   * such as a filter. A recursive filter is limited by the latency of its
+   * feedback, and doing both in one loop hides the interpolation behind it.
+   */
+  template<class Storage, class Function>
+  void read(CircularSampleBuffer<Storage>* buffer, float from, float to, float* destination, size_t len, Function process){
+    float step = (to - from)*(1.0f/(int)len); // the reciprocal is off the critical path
+    float delay = from + (int)len - 1;
+    // the delay moves linearly, so the window is set by the first and last sample
+    float last = from + (len - 1)*step;
+    int first = (int)min(delay, last) - 2;
+    int size = (int)max(delay, last) + 3 - first;
+    float* x = first < 0 || mode == ALLPASS_INTERPOLATION ? NULL : buffer->getReadWindow(first, size);
+    if(x == NULL){
+      for(size_t i=0; i<len; i++){
+	destination[i] = process(read(buffer, delay));
+	delay += step - 1;
+      }
+      return;
+    }
+    // x[j] is at delay first+size-j, so sample i is at window position
+    // offset + i*slope + i. The delay moves slowly, and the integer part of
+    // offset + i*slope changes at most a few times per block: within each
+    // run the loads are contiguous, with a linearly changing fraction.
+    float offset = first + size - delay;
+    float slope = -step;
+    size_t i = 0;
+    while(i < len){
+      int k = (int)(offset + (int)i*slope);
+      size_t end = len;
+      if((int)(offset + (int)(len-1)*slope) != k){
+	// first sample past the run, where the offset leaves [k, k+1]
+	float limit = (slope > 0 ? (k + 1 - offset)/slope : (offset - k)/-slope) + 1;
+	end = limit < len ? max(i+1, (size_t)limit) : len;
+      }
+      float* p = x + k;
+      for(; i<end; i++){
+	float frac = offset + (int)i*slope - k; // int converts to float faster than size_t
+	if(mode == LINEAR_INTERPOLATION)
+	  destination[i] = process(p[i] + (p[i+1] - p[i])*frac);
+	else
+	  destination[i] = process(hermite(p[i-1], p[i], p[i+1], p[i+2], frac));
+      }
+    }
+  }
+
+  /**
+   * read a block of @param len samples with a separate delay for every
+   * sample, for modulated delays
+   */
+  template<class Storage>
+  void read(CircularSampleBuffer<Storage>* buffer, float* delays, float* destination, size_t len){
+    for(size_t i=0; i<len; i++)
+      destination[i] = read(buffer, delays[i]+len-1-i);
+  }
+};
+
+#endif // __FractionalDelay_hpp__
@@ -0,0 +1,98 @@
+#ifndef __HalfbandFilter_hpp__
+#define __HalfbandFilter_hpp__
+
+#include "FloatArray.h"
+#include "MemoryTier.hpp"
+
+/**
+ * A 19 tap halfband lowpass: every other tap is zero, except for the
+ * centre tap of 1/2, so only the HALFBAND_TAPS coefficients either side
+ * of the centre are stored. Kaiser windowed, it is flat to within 0.03dB
+ * up to a sixth of the sample rate and at least 48dB down from a third.
+ */
+#define HALFBAND_TAPS 5
+static const float halfbandCoefficients[HALFBAND_TAPS] = {
+  0.311478155, -0.087147521, 0.035917545, -0.013376536, 0.003128356
+};
+
+/**
+ * Halves the sample rate with a polyphase halfband filter, computing
+ * only the outputs that are kept. The input is delayed by
+ * 2*HALFBAND_TAPS-1 samples.
+ */
+class HalfbandDecimator {
+private:
+  static const size_t HISTORY = 4*HALFBAND_TAPS-2;
+  FloatArray buffer; // history followed by the input block
+public:
+  HalfbandDecimator(FloatArray buf) : buffer(buf) {}
+
+  /**
+   * filter @param len samples of @param input into len/2 samples of
+   * @param output, which may be the same array
+   */
+  void process(const float* input, float* output, size_t len){
+    ASSERT(len + HISTORY <= buffer.getSize() && (len & 1) == 0, "Invalid decimator block size");
+    float* x = buffer.getData();
+    memcpy(x + HISTORY, input, len*sizeof(float));
+    for(size_t n=0; n<len/2; n++){
+      float* centre = x + 2*n + 2*HALFBAND_TAPS-1;
+      float y = 0.5f*centre[0];
+      for(int k=0; k<HALFBAND_TAPS; k++)
+	y += halfbandCoefficients[k]*(centre[-2*k-1] + centre[2*k+1]);
+      output[n] = y;
+    }
+    memmove(x, x + len, HISTORY*sizeof(float));
+  }
+
+  static HalfbandDecimator* create(int blocksize){
+    return MemoryTiers::get().create<HalfbandDecimator>(HOT_MEMORY, MemoryTiers::get().createFloatArray(blocksize + HISTORY, HOT_MEMORY));
+  }
+
+  static void destroy(HalfbandDecimator* decimator){
+    MemoryTiers::get().destroy(decimator->buffer);
+    MemoryTiers::get().destroy(decimator);
+  }
+};
+
+/**
+ * Doubles the sample rate with a polyphase halfband filter: every other
+ * output is a delayed input sample, the ones in between are interpolated.
+ * The input is delayed by 2*HALFBAND_TAPS-1 output samples.
+ */
+class HalfbandInterpolator {
+private:
+  static const size_t HISTORY = 2*HALFBAND_TAPS-1;
+  FloatArray buffer; // history followed by the input block
+public:
+  HalfbandInterpolator(FloatArray buf) : buffer(buf) {}
+
+  /**
+   * filter @param len samples of @param input into 2*len samples of @param output
+   */
+  void process(const float* input, float* output, size_t len){
+    ASSERT(len + HISTORY <= buffer.getSize(), "Invalid interpolator block size");
+    float* x = buffer.getData();
+    memcpy(x + HISTORY, input, len*sizeof(float));
+    for(size_t n=0; n<len; n++){
+      float* centre = x + n + HALFBAND_TAPS;
+      float y = 0;
+      for(int k=0; k<HALFBAND_TAPS; k++)
+	y += halfbandCoefficients[k]*(centre[-k-1] + centre[k]);
+      output[2*n] = 2*y; // the zeros in between the inputs halve the gain
+      output[2*n+1] = centre[0];
+    }
+    memmove(x, x + len, HISTORY*sizeof(float));
+  }
+
+  static HalfbandInterpolator* create(int blocksize){
+    return MemoryTiers::get().create<HalfbandInterpolator>(HOT_MEMORY, MemoryTiers::get().createFloatArray(blocksize + HISTORY, HOT_MEMORY));
+  }
+
+  static void destroy(HalfbandInterpolator* interpolator){
+    MemoryTiers::get().destroy(interpolator->buffer);
+    MemoryTiers::get().destroy(interpolator);
+  }
+};
+
+#endif // __HalfbandFilter_hpp__
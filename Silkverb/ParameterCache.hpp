@@ -0,0 +1,63 @@
+#ifndef __ParameterCache_hpp__
+#define __ParameterCache_hpp__
+
+/**
+ * Remembers the parameter values that coefficients were last computed
+ * from, so that a patch only recomputes them when a value has moved.
+ * Each slot has a hysteresis threshold: changes no larger than the
+ * threshold are ignored, which also keeps ADC noise from triggering
+ * recomputation. A threshold of 0 reports any change.
+ */
+template<int SIZE>
+class ParameterCache {
+private:
+  float values[SIZE];
+  float thresholds[SIZE];
+  bool valid[SIZE];
+public:
+  ParameterCache(float threshold = 0.0f){
+    for(int i=0; i<SIZE; i++){
+      values[i] = 0;
+      thresholds[i] = threshold;
+      valid[i] = false;
+    }
+  }
+
+  void setThreshold(int index, float threshold){
+    thresholds[index] = threshold;
+  }
+
+  /**
+   * store @param value in slot @param index if the slot is empty or the value
+   * has moved by more than the slot threshold.
+   * @return true if the value was stored, ie if dependent coefficients need updating
+   */
+  bool update(int index, float value){
+    if(valid[index] && abs(value - values[index]) <= thresholds[index])
+      return false;
+    values[index] = value;
+    valid[index] = true;
+    return true;
+  }
+
+  /**
+   * get the last stored value of slot @param index
+   */
+  float get(int index){
+    return values[index];
+  }
+
+  float operator[](int index){
+    return values[index];
+  }
+
+  /**
+   * empty all slots, so that the next update of each reports a change
+   */
+  void invalidate(){
+    for(int i=0; i<SIZE; i++)
+      valid[i] = false;
+  }
+};
+
+#endif // __ParameterCache_hpp__
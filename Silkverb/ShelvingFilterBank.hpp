@@ -0,0 +1,96 @@
+#ifndef __ShelvingFilterBank_hpp__
+#define __ShelvingFilterBank_hpp__
+
+#include "FloatArray.h"
+
+/**
+ * A first order low shelf followed by a first order high shelf, for
+ * each of LANES signals. A shelf has a gain of 1 on one side of its
+ * cutoff and its own gain on the other side.
+ *
+ * The lanes are processed together, one sample of every lane at a time,
+ * with the coefficients and state of each section stored lane by lane.
+ * The feedback chains of the lanes do not depend on each other, so they
+ * can overlap in the FPU pipeline, and on targets with SIMD the compiler
+ * can put the lanes in vector registers.
+ */
+template<int LANES>
+class ShelvingFilterBank {
+private:
+  float lowB0[LANES], lowB1[LANES], lowA1[LANES];
+  float highB0[LANES], highB1[LANES], highA1[LANES];
+  float x1[LANES], y1[LANES], z1[LANES];
+
+  /* the bilinear transform constant for a @param cutoff in cycles per sample */
+  static float warp(float cutoff){
+    return tanf(M_PI*cutoff);
+  }
+public:
+  ShelvingFilterBank(){
+    for(int i=0; i<LANES; i++){
+      setLowShelf(i, 0.25, 1);
+      setHighShelf(i, 0.25, 1);
+    }
+    reset();
+  }
+
+  void reset(){
+    for(int i=0; i<LANES; i++)
+      x1[i] = y1[i] = z1[i] = 0;
+  }
+
+  /**
+   * set @param lane to a gain of @param gain below @param cutoff, in
+   * cycles per sample, and 1 above it
+   */
+  void setLowShelf(int lane, float cutoff, float gain){
+    float k = warp(cutoff);
+    lowB0[lane] = (1 + gain*k)/(1 + k);
+    lowB1[lane] = (gain*k - 1)/(1 + k);
+    lowA1[lane] = (1 - k)/(1 + k);
+  }
+
+  /**
+   * set @param lane to a gain of 1 below @param cutoff, in cycles per
+   * sample, and @param gain above it
+   */
+  void setHighShelf(int lane, float cutoff, float gain){
+    float k = warp(cutoff);
+    highB0[lane] = (gain + k)/(1 + k);
+    highB1[lane] = (k - gain)/(1 + k);
+    highA1[lane] = (1 - k)/(1 + k);
+  }
+
+  /**
+   * filter @param len samples of each lane in place, with lane i in @param lanes[i]
+   */
+  void process(float** lanes, size_t len){
+    // interleave a chunk of the lanes, so that the filter loop reads
+    // and writes one sample of every lane at a time, which the compiler
+    // can unroll or vectorize
+    static const size_t CHUNK = 16;
+    float chunk[CHUNK][LANES];
+    for(size_t n=0; n<len; n+=CHUNK){
+      size_t size = min(CHUNK, len - n);
+      for(int i=0; i<LANES; i++)
+	for(size_t j=0; j<size; j++)
+	  chunk[j][i] = lanes[i][n+j];
+      for(size_t j=0; j<size; j++){
+	float* x = chunk[j];
+	for(int i=0; i<LANES; i++){
+	  float y = lowB0[i]*x[i] + lowB1[i]*x1[i] + lowA1[i]*y1[i];
+	  float z = highB0[i]*y + highB1[i]*y1[i] + highA1[i]*z1[i];
+	  x1[i] = x[i];
+	  y1[i] = y;
+	  z1[i] = z;
+	  x[i] = z;
+	}
+      }
+      for(int i=0; i<LANES; i++)
+	for(size_t j=0; j<size; j++)
+	  lanes[i][n+j] = chunk[j][i];
+    }
+  }
+};
+
+#endif // __ShelvingFilterBank_hpp__
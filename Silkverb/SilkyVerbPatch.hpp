@@ -4,7 +4,14 @@
 #include "Patch.h"
 #include "DcFilter.hpp"
 #include "CircularBuffer.hpp"
+#include "CrossFadeBuffer.hpp"
 #include "TapTempo.hpp"
+#include "TempoLfo.hpp"
+#include "ParameterCache.hpp"
+#include "FractionalDelay.hpp"
+#include "ShelvingFilterBank.hpp"
+#include "EarlyReflections.hpp"
+#include "HalfbandFilter.hpp"
 
 /**
  
@@ -54,6 +61,23 @@ DESCRIPTION:
 UPDATES:
     2020 Martin Klang: Refactored. Cross-fade delay positions for smooth size changes. 
                        Tap tempo pre-delay.
+    Modulation: each delay line is lengthened by up to 2x MAX_MODULATION
+    samples by a slow sine LFO of its own, which breaks up the metallic
+    ringing of long tails. At zero the delays are fixed, as before.
+    Low and High Time set the decay below LOW_CROSSOVER and above
+    HIGH_CROSSOVER, from 1/4 to 4 times Time, with a shelf pair per node.
+    Early adds early reflections to the input of the delay network, from
+    taps on the pre-delay lines spread over one Size after the pre-delay.
+    With FDN_DECIMATION set to 2, the delay network runs at half the
+    sample rate, on half blocks and half the node memory: its input is
+    decimated and its output interpolated by halfband filters, which
+    band-limit the reverb to a sixth of the sample rate.
+    Holding B for FREEZE_HOLD freezes the tail: the input to the delay
+    network fades out and its decay and damping fade to none over
+    FREEZE_FADE, after which the nodes hold their contents indefinitely,
+    with no coefficients to update, and the modulation stops. A shorter
+    press of B sets the pre-delay to zero, as before; on modules with a
+    third button, C does too.
 */
 
 #define MAX_REVERB_TIME   16
@@ -64,6 +88,11 @@ UPDATES:
 #define MIN_CUTOFF        0.1134
 #define MAX_PREDELAY_SIZE 32768
 #define MIN_PREDELAY_SIZE 0
+#define MAX_MODULATION    16 // samples, either side of the centre
+#define LOW_CROSSOVER     250  // Hz
+#define HIGH_CROSSOVER    4000 // Hz
+#define FREEZE_FADE       0.05 // seconds to fade in and out of freeze
+#define FREEZE_HOLD       0.25 // seconds B is held before it freezes
 
 #define SQRT8             2.82842712474619  // sqrtf(8)
 #define ONE_OVER_SQRT8    0.353553390593274 //  1/sqrtf(8)
@@ -72,110 +101,224 @@ UPDATES:
 //       the longest delay is coupled to the room size.
 //       the delay lines then decrease exponentially in length.
 
-#define PRIME_NUMBER_TABLE_SIZE 7600
-uint32_t  primeNumberTable[PRIME_NUMBER_TABLE_SIZE];
-// the 7600th prime is 77351
+// #define USE_COMPACT_DELAY
 
-#define BUFFER_LIMIT 8192
-#define TRIGGER_LIMIT 65536
+#ifdef USE_COMPACT_DELAY
+typedef CrossFadeBlockFloatBuffer DelayBuffer; // half the memory of float
+#else
+typedef CrossFadeBuffer DelayBuffer;
+#endif
 
-void BuildPrimeTable(uint32_t* prime_number_table){
-  uint16_t max_stride = (uint16_t)sqrtf(PRIME_NUMBER_TABLE_SIZE);
-  for(size_t i=0; i<PRIME_NUMBER_TABLE_SIZE; i++)
-    prime_number_table[i] = 1;         // initial value of all entries is 1 
-  prime_number_table[0] = 0;          // now we zero out any entry that is not prime
-  prime_number_table[1] = 0;
-  uint16_t stride = 2;             // start with stride set to the smallest prime
-  while (stride <= max_stride){
-    for(size_t i=2*stride; i<PRIME_NUMBER_TABLE_SIZE; i+=stride) // start at the 2nd multiple of this prime, NOT the prime number itself!!!
-      prime_number_table[i] = 0;        // zero out table entries for all multiples of this prime number
-    stride++;
-    while (prime_number_table[stride] == 0)      // go to next non-zero entry which is the next prime
-      stride++;
-  }
-}
+// #define FDN_DECIMATION 2 // run the delay network at half the sample rate
 
-uint32_t FindNearestPrime(uint32_t* prime_number_table, uint16_t number)
-{
-  while (prime_number_table[number] == 0)
-    number--;
-  return number;
-}
+#ifndef FDN_DECIMATION
+#define FDN_DECIMATION 1
+#endif
+#if FDN_DECIMATION != 1 && FDN_DECIMATION != 2
+#error "FDN_DECIMATION must be 1 or 2"
+#endif
 
-class CrossFadeBuffer : public CircularBuffer {
-private:
-  int readIndex = 0;
-public:
-  CrossFadeBuffer(){}
-  CrossFadeBuffer(FloatArray buf) : CircularBuffer(buf){}
+#define PRIME_NUMBER_TABLE_SIZE 7600
 
-  void fade(int readIndex, FloatArray destination){
-    fade(readIndex, destination.getData(), destination.getSize());
+/* early reflection times, as fractions of the room size, and gains, for each side */
+static const float earlyTimes[2][EARLY_TAPS] = {
+  { 0.071, 0.137, 0.213, 0.293, 0.389, 0.511, 0.653, 0.829 },
+  { 0.089, 0.157, 0.229, 0.331, 0.421, 0.547, 0.701, 0.883 }
+};
+static const float earlyGains[2][EARLY_TAPS] = {
+  { 0.50, -0.43, 0.38, 0.33, -0.28, 0.24, -0.20, 0.16 },
+  { 0.49, 0.41, -0.36, 0.31, -0.26, 0.22, 0.19, -0.15 }
+};
+
+/**
+ * Sieve of Eratosthenes, evaluated at compile time into one bit per
+ * number so that the table lives in flash.
+ */
+class PrimeNumberTable {
+private:
+  uint32_t bits[(PRIME_NUMBER_TABLE_SIZE+31)/32];
+  constexpr void clear(size_t number){
+    bits[number>>5] &= ~(1u<<(number&31));
   }
-  void fade(int newReadIndex, float* destination, size_t len){
-    for(size_t i=0; i<len; i++){
-      float x1 = i/(float)len;
-      float x0 = 1.0-x1;
-      *destination++ = read(readIndex+len-i)*x0 + read(newReadIndex+len-i)*x1;
-    }
-    readIndex = newReadIndex;
+public:
+  constexpr PrimeNumberTable() : bits() {
+    for(size_t i=2; i<PRIME_NUMBER_TABLE_SIZE; i++)
+      bits[i>>5] |= 1u<<(i&31);
+    for(size_t stride=2; stride*stride<PRIME_NUMBER_TABLE_SIZE; stride++)
+      if(isPrime(stride))
+        for(size_t i=2*stride; i<PRIME_NUMBER_TABLE_SIZE; i+=stride) // start at the 2nd multiple of this prime
+          clear(i);
   }
-  static CrossFadeBuffer* create(int samples){
-    return new CrossFadeBuffer(FloatArray::create(samples));
+  constexpr bool isPrime(uint32_t number) const {
+    return bits[number>>5] & (1u<<(number&31));
   }
-
-  static void destroy(CrossFadeBuffer* buf){
-    CircularBuffer::destroy(buf);
+  /**
+   * find the largest prime less than or equal to @param number,
+   * scanning a word of the table at a time
+   */
+  uint32_t findNearestPrime(uint32_t number) const {
+    if(number >= PRIME_NUMBER_TABLE_SIZE)
+      number = PRIME_NUMBER_TABLE_SIZE-1;
+    size_t index = number>>5;
+    uint32_t word = bits[index] & (0xffffffffu >> (31 - (number&31)));
+    while(word == 0 && index > 0)
+      word = bits[--index];
+    if(word == 0)
+      return 0;
+    return index*32 + 31 - __builtin_clz(word);
   }
 };
 
+static constexpr PrimeNumberTable primeNumberTable;
+
+#define BUFFER_LIMIT 8192
+#define TRIGGER_LIMIT 65536
+
+uint32_t FindNearestPrime(uint16_t number){
+  return primeNumberTable.findNearestPrime(number);
+}
+
+/**
+ * convert the coefficient @param a of a one pole lowpass, or of the one
+ * zero filter that compensates it, to the rate of the delay network. The
+ * response of either is set by 4a/(1-a)^2 times sin^2 of half the
+ * frequency, in radians per sample, which is kept at low frequencies.
+ */
+float DecimateCoefficient(float a){
+#if FDN_DECIMATION > 1
+  float q = a/((1-a)*(1-a)*FDN_DECIMATION*FDN_DECIMATION);
+  return 2*q/(2*q + 1 + sqrtf(4*q + 1)); // the root of q(1-x)^2 = x below 1
+#else
+  return a;
+#endif
+}
+
 class Node {
 private:
   size_t delay_samples;
+  int readIndex;
   float b0, a1, y1;
   FloatArray result;
-  CrossFadeBuffer* buffer;
+  DelayBuffer* buffer;
+  FractionalDelay<LINEAR_INTERPOLATION> tap;
+  float modulated; // last modulated delay
+  float sine, cosine; // LFO, turned by one block at a time
+  float turnSine, turnCosine;
 public:
   Node(size_t bufsize):
-    a1(0), b0(-ONE_OVER_SQRT8), y1(0) {
-    result = FloatArray::create(bufsize);
-    buffer = CrossFadeBuffer::create(BUFFER_LIMIT);
+    delay_samples(0), readIndex(0), b0(-ONE_OVER_SQRT8), a1(0), y1(0), modulated(1),
+    sine(0), cosine(1), turnSine(0), turnCosine(1) {
+    result = MemoryTiers::get().createFloatArray(bufsize, HOT_MEMORY);
+    buffer = DelayBuffer::create(BUFFER_LIMIT/FDN_DECIMATION, bufsize, HOT_MEMORY);
   }
   ~Node(){
-    FloatArray::destroy(result);
-    CrossFadeBuffer::destroy(buffer);
+    MemoryTiers::get().destroy(result);
+    DelayBuffer::destroy(buffer);
   }
   float* getResult(){
     return result.getData();
   }
+  /* get the delay length the decay is computed for, in samples */
+  size_t getLength(){
+    return delay_samples + result.getSize();
+  }
   void write(float sample){
     buffer->write(sample);
   }
-  float filter(float x){
-    y1 = b0*x + a1*y1; // b0*x[n] + a1*y[n-1]
-    return y1;
+  void write(float* source, size_t len){
+    buffer->write(source, len);
+  }
+  /**
+   * set the modulation LFO to @param frequency in cycles per sample,
+   * starting at @param offset of a cycle
+   */
+  void setModulation(float frequency, float offset){
+    float turn = frequency*result.getSize()*2*M_PI;
+    turnSine = sinf(turn);
+    turnCosine = cosf(turn);
+    sine = sinf(offset*2*M_PI);
+    cosine = cosf(offset*2*M_PI);
+  }
+  /**
+   * get the length of the loop through the node for a delay of @param
+   * fDelaySamples: the nearest prime, but at least one block long, even
+   * for small rooms and large blocks
+   */
+  uint32_t getLoopLength(float fDelaySamples){
+    return max(FindNearestPrime((int)fDelaySamples), (uint32_t)result.getSize());
   }
   void set(float beta, float fDelaySamples, float fCutoffCoef){
-    float prime_value = FindNearestPrime(primeNumberTable, (int)fDelaySamples);
+    float prime_value = getLoopLength(fDelaySamples);
     // we subtract 1 CHUNK of delay, because this signal feeds back, causing an extra CHUNK delay
     delay_samples = prime_value - result.getSize();
-    a1 = prime_value*fCutoffCoef;
+    a1 = DecimateCoefficient(prime_value*fCutoffCoef);
     b0 = ONE_OVER_SQRT8*expf(beta*prime_value)*(a1-1);
   }
   void process(){
-    buffer->fade(delay_samples, result);
+    buffer->fade(readIndex, delay_samples, result.getData(), result.getSize());
+    readIndex = delay_samples;
+    modulated = readIndex + 1; // a block read index is one sample short of the delay
+    filter();
+  }
+  /**
+   * process with the delay modulated by up to 2x @param depth samples.
+   * The delay moves linearly from its value at the last block, unless the
+   * size has changed, when it crossfades to the new delay instead. At a
+   * depth of 0 the delay glides back to the fixed tap over one block,
+   * after which the unmodulated process() takes over.
+   */
+  void process(float depth){
+    if(depth == 0 && modulated == readIndex + 1){
+      process();
+      return;
+    }
+    size_t len = result.getSize();
+    float delay = delay_samples + 1 + depth*(1 + sine);
+    // turn the LFO for the next block, off the path to the read
+    float s = sine*turnCosine + cosine*turnSine;
+    cosine = cosine*turnCosine - sine*turnSine;
+    sine = s;
+    float gain = 1.5f - 0.5f*(sine*sine + cosine*cosine); // hold the amplitude at 1
+    sine *= gain;
+    cosine *= gain;
+    if(delay_samples == (size_t)readIndex){
+      float b = b0, a = a1, y = y1; // locals, which the output cannot alias
+      tap.read(buffer, modulated, delay, result.getData(), len, [&](float x){ return y = b*x + a*y; });
+      y1 = y;
+    }else{
+      int index = (int)(delay + 0.5f) - 1;
+      buffer->fade((int)(modulated + 0.5f) - 1, index, result.getData(), len);
+      filter();
+      readIndex = delay_samples;
+      delay = index + 1;
+    }
+    modulated = delay;
+  }
+  void filter(){
+    float b = b0, a = a1, y = y1; // locals, which the result cannot alias
     for(size_t i=0; i<result.getSize(); ++i)
-      result[i] = filter(result[i]);
+      result[i] = y = b*result[i] + a*y; // b0*x[n] + a1*y[n-1]
+    y1 = y;
   }
 };
 
 class SilkyVerbPatch : public Patch {
+  MemoryRegions regions;
   TapTempo<TRIGGER_LIMIT> tempo;
-  int tempocounter;
+  TempoLfo clock;
   StereoDcFilter dc;
-  CrossFadeBuffer* delayBufferL;
-  CrossFadeBuffer* delayBufferR;
+  DelayBuffer* delayBufferL;
+  DelayBuffer* delayBufferR;
   FloatArray preL, preR;
+  EarlyReflections* earlyL;
+  EarlyReflections* earlyR;
+  FloatArray feedback;
+#if FDN_DECIMATION > 1
+  HalfbandDecimator* decimatorL;
+  HalfbandDecimator* decimatorR;
+  HalfbandInterpolator* interpolatorL;
+  HalfbandInterpolator* interpolatorR;
+#endif
   float fPreDelaySamples;
 
   float   dry_coef;
@@ -197,21 +340,42 @@ class SilkyVerbPatch : public Patch {
   FloatParameter time;
   FloatParameter cutoff;
   FloatParameter wet;
+  enum { CACHE_SIZE, CACHE_TIME, CACHE_CUTOFF, CACHE_WET, CACHE_MODULATION, CACHE_LOW, CACHE_HIGH, CACHE_EARLY, CACHE_COUNT };
+  ParameterCache<CACHE_COUNT> cache;
+  float cutoffCoef;
+  ShelvingFilterBank<8> shelves;
+  bool shelving;
+  bool frozen;
+  int pressed; // samples B has been held for, or -1 when released
+  float freeze; // how far the freeze has faded in, from 0 to 1
 
 public:
-  SilkyVerbPatch() : tempo(getSampleRate()*60/120),
-		     node0(getBlockSize()),
-		     node1(getBlockSize()),
-		     node2(getBlockSize()),
-		     node3(getBlockSize()),
-		     node4(getBlockSize()),
-		     node5(getBlockSize()),
-		     node6(getBlockSize()),
-		     node7(getBlockSize()) {
-    delayBufferL = CrossFadeBuffer::create(MAX_PREDELAY_SIZE);
-    delayBufferR = CrossFadeBuffer::create(MAX_PREDELAY_SIZE);
-    preL = FloatArray::create(getBlockSize());
-    preR = FloatArray::create(getBlockSize());
+  SilkyVerbPatch() : regions((BUFFER_LIMIT/FDN_DECIMATION*8 + getBlockSize()*32)*sizeof(float),
+			     MAX_PREDELAY_SIZE*2*sizeof(float)), // the nodes and blocks; the pre-delay lines
+		     tempo(getSampleRate()*60/120),
+		     node0(getBlockSize()/FDN_DECIMATION),
+		     node1(getBlockSize()/FDN_DECIMATION),
+		     node2(getBlockSize()/FDN_DECIMATION),
+		     node3(getBlockSize()/FDN_DECIMATION),
+		     node4(getBlockSize()/FDN_DECIMATION),
+		     node5(getBlockSize()/FDN_DECIMATION),
+		     node6(getBlockSize()/FDN_DECIMATION),
+		     node7(getBlockSize()/FDN_DECIMATION),
+		     shelving(false), frozen(false), pressed(-1), freeze(0) {
+    preL = MemoryTiers::get().createFloatArray(getBlockSize(), HOT_MEMORY);
+    preR = MemoryTiers::get().createFloatArray(getBlockSize(), HOT_MEMORY);
+    feedback = MemoryTiers::get().createFloatArray(getBlockSize()/FDN_DECIMATION*8, HOT_MEMORY);
+#if FDN_DECIMATION > 1
+    ASSERT(getBlockSize() % FDN_DECIMATION == 0, "Block size must be a multiple of FDN_DECIMATION");
+    decimatorL = HalfbandDecimator::create(getBlockSize());
+    decimatorR = HalfbandDecimator::create(getBlockSize());
+    interpolatorL = HalfbandInterpolator::create(getBlockSize()/FDN_DECIMATION);
+    interpolatorR = HalfbandInterpolator::create(getBlockSize()/FDN_DECIMATION);
+#endif
+    delayBufferL = DelayBuffer::create(MAX_PREDELAY_SIZE, getBlockSize(), BULK_MEMORY);
+    delayBufferR = DelayBuffer::create(MAX_PREDELAY_SIZE, getBlockSize(), BULK_MEMORY);
+    earlyL = EarlyReflections::create(getBlockSize());
+    earlyR = EarlyReflections::create(getBlockSize());
 
     static const float delta = 0.05;
     size = getFloatParameter("Size", MIN_ROOM_SIZE, MAX_ROOM_SIZE);
@@ -221,18 +385,42 @@ public:
     registerParameter(PARAMETER_E, "Pre-delay");
     registerParameter(PARAMETER_F, "LFO Sine>");
     registerParameter(PARAMETER_G, "LFO Ramp>");
-    
+    registerParameter(PARAMETER_H, "Modulation");
+    setModulation();
+    registerParameter(PARAMETER_AA, "Low Time");
+    registerParameter(PARAMETER_AB, "High Time");
+    setParameterValue(PARAMETER_AA, 0.5); // same as Time
+    setParameterValue(PARAMETER_AB, 0.5);
+    registerParameter(PARAMETER_AC, "Early");
+
     left_reverb_state = 0.0;
     right_reverb_state = 0.0;
- 
-    BuildPrimeTable(primeNumberTable);
+    // ignore changes below 1/2048 of the parameter range
+    cache.setThreshold(CACHE_SIZE, (MAX_ROOM_SIZE-MIN_ROOM_SIZE)/2048.0);
+    cache.setThreshold(CACHE_TIME, (MAX_REVERB_TIME-MIN_REVERB_TIME)/2048.0);
+    cache.setThreshold(CACHE_CUTOFF, (MAX_CUTOFF-MIN_CUTOFF)/2048.0);
+    cache.setThreshold(CACHE_WET, 1/2048.0);
+    cache.setThreshold(CACHE_MODULATION, MAX_MODULATION/2048.0);
+    cache.setThreshold(CACHE_LOW, 1/2048.0);
+    cache.setThreshold(CACHE_HIGH, 1/2048.0);
+    cache.setThreshold(CACHE_EARLY, 1/2048.0);
+    MemoryTiers::get().report();
   }
 
   ~SilkyVerbPatch(){
-    CrossFadeBuffer::destroy(delayBufferL);
-    CrossFadeBuffer::destroy(delayBufferR);
-    FloatArray::destroy(preL);
-    FloatArray::destroy(preR);
+    DelayBuffer::destroy(delayBufferL);
+    DelayBuffer::destroy(delayBufferR);
+    EarlyReflections::destroy(earlyL);
+    EarlyReflections::destroy(earlyR);
+    MemoryTiers::get().destroy(preL);
+    MemoryTiers::get().destroy(preR);
+    MemoryTiers::get().destroy(feedback);
+#if FDN_DECIMATION > 1
+    HalfbandDecimator::destroy(decimatorL);
+    HalfbandDecimator::destroy(decimatorR);
+    HalfbandInterpolator::destroy(interpolatorL);
+    HalfbandInterpolator::destroy(interpolatorR);
+#endif
   }
 
   int delaySamples(){
@@ -250,45 +438,63 @@ public:
     case BUTTON_A:
       tempo.trigger(set, samples);
       setButton(PUSHBUTTON, value);
-      tempocounter = 0;
       break;
     case BUTTON_B:
+      if(set){
+	pressed = 0; // hold to freeze the tail
+      }else{
+	if(pressed >= 0 && !frozen)
+	  tempo.setLimit(0); // tap to set pre-delay to zero
+	pressed = -1;
+	frozen = false;
+      }
+      break;
+    case BUTTON_C:
       if(set)
 	tempo.setLimit(0); // set pre-delay to zero
       break;
     }
   }
     
-  void processAudio(AudioBuffer &buffer){
-    FloatArray left_input = buffer.getSamples(0);
-    FloatArray right_input = buffer.getSamples(1);
-    size_t len = buffer.getSize();
-    tempo.clock(len);
-    tempo.setSpeed(getParameterValue(PARAMETER_E)*4096);
-    dc.process(buffer); // remove DC offset
+  /* get the sample rate of the delay network */
+  float getNodeRate(){
+    return getSampleRate()/FDN_DECIMATION;
+  }
 
-    float fCutoffCoef  = expf(-6.28318530717959*cutoff);
-    float fRoomSizeSamples = size;
-    float fReverbTimeSamples = time*getSampleRate();
-    
-    dry_coef = 1.0 - wet;
-    if(wet > 0){
-      float dryWet = wet * SQRT8 * (1.0 - expf(-10*fRoomSizeSamples/(fReverbTimeSamples*0.125)));
-      // additional attenuation for small room and long reverb time  <--  expf(-13.8155105579643) = 10^(-60dB/10dB)
-      // gain compensation: toss in whatever fudge factor you need here to make the reverb louder
-      wet_coef0 = dryWet;
-      wet_coef1 = -fCutoffCoef*dryWet;
-    }else{
-      wet_coef0 = 0;
-      wet_coef1 = 0;
+  /* give each node an LFO of its own, at unrelated rates and spread phases */
+  void setModulation(){
+    static const float rates[] = { 0.31, 0.37, 0.43, 0.53, 0.59, 0.67, 0.73, 0.83 }; // Hz
+    Node* nodes[] = { &node0, &node1, &node2, &node3, &node4, &node5, &node6, &node7 };
+    for(int i=0; i<8; i++)
+      nodes[i]->setModulation(rates[i]/getNodeRate(), i/8.0f);
+  }
+
+  /* place the early reflections over one room size after the pre-delay */
+  void setEarly(){
+    float length = cache[CACHE_SIZE];
+    float level = cache[CACHE_EARLY];
+    int limit = MAX_PREDELAY_SIZE - getBlockSize() - 1; // longest block read
+    for(int i=0; i<EARLY_TAPS; i++){
+      earlyL->setTap(i, min(limit, (int)(fPreDelaySamples + earlyTimes[0][i]*length)), level*earlyGains[0][i]);
+      earlyR->setTap(i, min(limit, (int)(fPreDelaySamples + earlyTimes[1][i]*length)), level*earlyGains[1][i]);
     }
-    
-    fCutoffCoef /= (float)FindNearestPrime(primeNumberTable, fRoomSizeSamples);
- 
-    float fDelaySamples = fRoomSizeSamples;
+  }
+
+  /**
+   * recompute node delay lengths and filter coefficients, at the network
+   * rate. The decay and damping fade out as the freeze fades in.
+   */
+  void setNodes(){
+    float loss = 1 - freeze;
+    float fCutoffCoef  = expf(-6.28318530717959*cache[CACHE_CUTOFF]);
+    float fDelaySamples = cache[CACHE_SIZE]/FDN_DECIMATION;
+    float fReverbTimeSamples = cache[CACHE_TIME]*getNodeRate();
+    cutoffCoef = fCutoffCoef; // the output keeps its tone through a freeze
+    fCutoffCoef /= (float)node0.getLoopLength(fDelaySamples); // so the longest loop gets the cutoff
+    fCutoffCoef *= loss;
 
     // 6.90775527898214 = logf(10^(60dB/20dB))  <-- fReverbTime is RT60
-    float beta = -6.90775527898214/fReverbTimeSamples;
+    float beta = -6.90775527898214/fReverbTimeSamples*loss;
   
     node0.set(beta, fDelaySamples, fCutoffCoef);
     fDelaySamples *= ALPHA;
@@ -305,20 +511,121 @@ public:
     node6.set(beta, fDelaySamples, fCutoffCoef);
     fDelaySamples *= ALPHA; 
     node7.set(beta, fDelaySamples, fCutoffCoef);
+    setShelves(beta);
+  }
+
+  /**
+   * set the shelves from the low and high decay times, relative to the
+   * decay of the nodes with @param beta. Centred, both are the same as
+   * Time and the shelves are bypassed.
+   */
+  void setShelves(float beta){
+    // from 1/4 to 4 times Time
+    float low = exp2f(4*cache[CACHE_LOW] - 2);
+    float high = exp2f(4*cache[CACHE_HIGH] - 2);
+    shelving = (low != 1 || high != 1) && freeze < 1;
+    if(shelving){
+      Node* nodes[] = { &node0, &node1, &node2, &node3, &node4, &node5, &node6, &node7 };
+      for(int i=0; i<8; i++){
+	// the gain of a pass through the node, relative to its gain at Time
+	float length = nodes[i]->getLength();
+	shelves.setLowShelf(i, LOW_CROSSOVER/getNodeRate(), expf(beta*length*(1/low - 1)));
+	shelves.setHighShelf(i, HIGH_CROSSOVER/getNodeRate(), expf(beta*length*(1/high - 1)));
+      }
+    }
+  }
+
+  /* recompute the dry and wet output coefficients */
+  void setMix(){
+    float fRoomSizeSamples = cache[CACHE_SIZE];
+    float fReverbTimeSamples = cache[CACHE_TIME]*getSampleRate();
+    float mix = cache[CACHE_WET];
+    dry_coef = 1.0 - mix;
+    if(mix > 0){
+      float dryWet = mix * SQRT8 * (1.0 - expf(-10*fRoomSizeSamples/(fReverbTimeSamples*0.125)));
+      // additional attenuation for small room and long reverb time  <--  expf(-13.8155105579643) = 10^(-60dB/10dB)
+      // gain compensation: toss in whatever fudge factor you need here to make the reverb louder
+      // the same response at the network rate, at the same gain at DC
+      float coef = DecimateCoefficient(cutoffCoef);
+      dryWet *= (1 - cutoffCoef)/(1 - coef);
+      wet_coef0 = dryWet;
+      wet_coef1 = -coef*dryWet;
+    }else{
+      wet_coef0 = 0;
+      wet_coef1 = 0;
+    }
+  }
+
+  void processAudio(AudioBuffer &buffer){
+    FloatArray left_input = buffer.getSamples(0);
+    FloatArray right_input = buffer.getSamples(1);
+    size_t len = buffer.getSize();
+    tempo.clock(len);
+    tempo.setSpeed(getParameterValue(PARAMETER_E)*4096);
+    dc.process(buffer, delayBufferL, delayBufferR); // remove DC offset and write the pre-delay
+
+    if(pressed >= 0 && !frozen){
+      pressed += len;
+      frozen = pressed >= FREEZE_HOLD*getSampleRate();
+    }
+    float previous = freeze;
+    float fade = len/(FREEZE_FADE*getSampleRate());
+    freeze = frozen ? min(1.0f, freeze + fade) : max(0.0f, freeze - fade);
+    bool held = freeze == 1 && previous == 1; // fully frozen for the whole block
+
+    // while frozen the node parameters are left in the cache, to be
+    // picked up when the freeze is released
+    bool nodes = false;
+    if(!held){
+      // not short-circuited: every slot must be updated
+      nodes = cache.update(CACHE_SIZE, size) | cache.update(CACHE_TIME, time) | cache.update(CACHE_CUTOFF, cutoff) |
+	cache.update(CACHE_LOW, getParameterValue(PARAMETER_AA)) | cache.update(CACHE_HIGH, getParameterValue(PARAMETER_AB));
+      nodes |= freeze != previous;
+    }
+    if(nodes)
+      setNodes();
+    if(cache.update(CACHE_WET, wet) || nodes) // wet coefficients depend on size and time too
+      setMix();
 
     fPreDelaySamples = delaySamples();
-    delayBufferL->write(left_input);
-    delayBufferR->write(right_input);
-    delayBufferL->fade(fPreDelaySamples, preL);
-    delayBufferR->fade(fPreDelaySamples, preR);
-
-    tempocounter += len;
-    if(fPreDelaySamples && tempocounter >= fPreDelaySamples){
-      tempocounter -= fPreDelaySamples;
-      setButton(PUSHBUTTON, 4095);
-    }else if(tempocounter > fPreDelaySamples/4){
+    if(held){
+      preL.clear();
+      preR.clear();
+    }else{
+      delayBufferL->fade(fPreDelaySamples, preL);
+      delayBufferR->fade(fPreDelaySamples, preR);
+      cache.update(CACHE_EARLY, getParameterValue(PARAMETER_AC));
+      if(cache[CACHE_EARLY] > 0 || earlyL->isActive() || earlyR->isActive()){
+	setEarly(); // at 0, the taps fade out over one more block
+	earlyL->process(delayBufferL, preL, len);
+	earlyR->process(delayBufferR, preR, len);
+      }
+      if(freeze > 0 || previous > 0){
+	// fade the input to the network out as the freeze fades in
+	float from = 1 - previous;
+	float step = (previous - freeze)/len;
+	for(size_t i=0; i<len; i++){
+	  float gain = from + step*i;
+	  preL[i] *= gain;
+	  preR[i] *= gain;
+	}
+      }
+    }
+
+    if(fPreDelaySamples){
+      // clock out the pre-delay, which is a power of two division of the tempo
+      clock.setRatio(fPreDelaySamples/(tempo.getPeriod()*TRIGGER_LIMIT), 1);
+      clock.clock(tempo);
+      setButton(PUSHBUTTON, clock.getSquare(0.25) ? 4095 : 0);
+    }else{
       setButton(PUSHBUTTON, 0);
     }
+
+    size_t steps = len/FDN_DECIMATION; // samples per block in the delay network
+#if FDN_DECIMATION > 1
+    decimatorL->process(preL, preL, len);
+    decimatorR->process(preR, preR, len);
+#endif
     
     float* x0 = node0.getResult(); // lpf output from previous block
     float* x1 = node1.getResult();
@@ -329,110 +636,84 @@ public:
     float* x6 = node6.getResult();
     float* x7 = node7.getResult();
 
-    for(size_t i=0; i<len; i++){
-      float acc = preL[i];
-      acc += x0[i];
-      acc += x1[i];
-      acc += x2[i];
-      acc += x3[i];
-      acc -= x4[i];
-      acc -= x5[i];
-      acc -= x6[i];
-      acc -= x7[i];
-      node0.write(acc); // delay input
-    }
-
-    for(size_t i=0; i<len; i++){
-      float acc = preR[i];
-      acc += x0[i];
-      acc += x1[i];
-      acc -= x2[i];
-      acc -= x3[i];
-      acc += x4[i];
-      acc += x5[i];
-      acc -= x6[i];
-      acc -= x7[i];
-      node1.write(acc);
+    // The feedback matrix is an 8x8 Hadamard matrix: row k has the sign
+    // (-1)^popcount(k&j) for node j. Three butterfly stages compute all
+    // eight rows in 24 add/subs per sample; each node input takes one row.
+    float* y0 = feedback.getData();
+    float* y1 = y0 + steps;
+    float* y2 = y1 + steps;
+    float* y3 = y2 + steps;
+    float* y4 = y3 + steps;
+    float* y5 = y4 + steps;
+    float* y6 = y5 + steps;
+    float* y7 = y6 + steps;
+    for(size_t i=0; i<steps; i++){
+      float a0 = x0[i] + x1[i];
+      float a1 = x0[i] - x1[i];
+      float a2 = x2[i] + x3[i];
+      float a3 = x2[i] - x3[i];
+      float a4 = x4[i] + x5[i];
+      float a5 = x4[i] - x5[i];
+      float a6 = x6[i] + x7[i];
+      float a7 = x6[i] - x7[i];
+      float b0 = a0 + a2;
+      float b1 = a1 + a3;
+      float b2 = a0 - a2;
+      float b3 = a1 - a3;
+      float b4 = a4 + a6;
+      float b5 = a5 + a7;
+      float b6 = a4 - a6;
+      float b7 = a5 - a7;
+      y0[i] = preL[i] + (b0 - b4); // row 4: + + + + - - - -
+      y1[i] = preR[i] + (b2 + b6); // row 2: + + - - + + - -
+      y2[i] = preR[i] + (b2 - b6); // row 6: + + - - - - + +
+      y3[i] = preL[i] + (b1 + b5); // row 1: + - + - + - + -
+      y4[i] = preR[i] + (b1 - b5); // row 5: + - + - - + - +
+      y5[i] = preL[i] + (b3 + b7); // row 3: + - - + + - - +
+      y6[i] = preL[i] + (b3 - b7); // row 7: + - - + - + + -
+      y7[i] = preR[i] + (b0 + b4); // row 0: + + + + + + + +
     }
+    node0.write(y0, steps); // delay input
+    node1.write(y1, steps);
+    node2.write(y2, steps);
+    node3.write(y3, steps);
+    node4.write(y4, steps);
+    node5.write(y5, steps);
+    node6.write(y6, steps);
+    node7.write(y7, steps);
  
-    for(size_t i=0; i<len; i++){
-      float acc = preR[i];
-      acc += x0[i];
-      acc += x1[i];
-      acc -= x2[i];
-      acc -= x3[i];
-      acc -= x4[i];
-      acc -= x5[i];
-      acc += x6[i];
-      acc += x7[i];
-      node2.write(acc);
-    }
-
-    for(size_t i=0; i<len; i++){
-      float acc = preL[i];
-      acc += x0[i];
-      acc -= x1[i];
-      acc += x2[i];
-      acc -= x3[i];
-      acc += x4[i];
-      acc -= x5[i];
-      acc += x6[i];
-      acc -= x7[i];
-      node3.write(acc);
-    }
- 
-    for(size_t i=0; i<len; i++){
-      float acc = preR[i];
-      acc += x0[i];
-      acc -= x1[i];
-      acc += x2[i];
-      acc -= x3[i];
-      acc -= x4[i];
-      acc += x5[i];
-      acc -= x6[i];
-      acc += x7[i];
-      node4.write(acc);
-    }
-
-    for(size_t i=0; i<len; i++){
-      float acc = preL[i];
-      acc += x0[i];
-      acc -= x1[i];
-      acc -= x2[i];
-      acc += x3[i];
-      acc += x4[i];
-      acc -= x5[i];
-      acc -= x6[i];
-      acc += x7[i];
-      node5.write(acc);
+#if FDN_DECIMATION > 1
+    // mix the reverb at the network rate, then interpolate it up to the dry signal
+    float* reverb = feedback.getData(); // the node inputs have been written
+    float* upsampled = reverb + steps;
+    float reverb_output_state = left_reverb_state;
+    float rms = 0;
+    for(size_t i=0; i<steps; ++i){
+      float reverb_output = x0[i] + x2[i] + x4[i] + x6[i];
+      reverb[i] = wet_coef0 * reverb_output + wet_coef1 * reverb_output_state;
+      reverb_output_state = reverb_output;
+      rms += reverb_output*reverb_output;
     }
+    left_reverb_state = reverb_output_state;
+    setParameterValue(PARAMETER_F, sqrtf(rms/steps));
+    interpolatorL->process(reverb, upsampled, steps);
+    for(size_t i=0; i<len; ++i)
+      left_input[i] = dry_coef * left_input[i] + upsampled[i];
 
-    for(size_t i=0; i<len; i++){
-      float acc = preL[i];
-      acc += x0[i];
-      acc -= x1[i];
-      acc -= x2[i];
-      acc += x3[i];
-      acc -= x4[i];
-      acc += x5[i];
-      acc += x6[i];
-      acc -= x7[i];
-      node6.write(acc);
-    }
- 
-    for(size_t i=0; i<len; i++){
-      float acc = preR[i];
-      acc += x0[i];
-      acc += x1[i];
-      acc += x2[i];
-      acc += x3[i];
-      acc += x4[i];
-      acc += x5[i];
-      acc += x6[i];
-      acc += x7[i];
-      node7.write(acc);
+    reverb_output_state = right_reverb_state;
+    rms = 0;
+    for(size_t i=0; i<steps; ++i){
+      float reverb_output = x1[i] + x3[i] + x5[i] + x7[i];
+      reverb[i] = wet_coef0 * reverb_output + wet_coef1 * reverb_output_state;
+      reverb_output_state = reverb_output;
+      rms += reverb_output*reverb_output;
     }
- 
+    right_reverb_state = reverb_output_state;
+    setParameterValue(PARAMETER_G, sqrtf(rms/steps));
+    interpolatorR->process(reverb, upsampled, steps);
+    for(size_t i=0; i<len; ++i)
+      right_input[i] = dry_coef * right_input[i] + upsampled[i];
+#else
     float* input = left_input;
     float* output = left_input;
     float reverb_output_state = left_reverb_state;
@@ -464,15 +745,25 @@ public:
     }
     right_reverb_state = reverb_output_state;
     setParameterValue(PARAMETER_G, sqrtf(rms/len));
-
-    node0.process();
-    node1.process();
-    node2.process();
-    node3.process();
-    node4.process();
-    node5.process();
-    node6.process();
-    node7.process();
+#endif
+
+    cache.update(CACHE_MODULATION, getParameterValue(PARAMETER_H)*MAX_MODULATION);
+    float depth = cache[CACHE_MODULATION]/FDN_DECIMATION; // in network samples
+    if(freeze > 0)
+      depth = 0; // glide to the fixed taps, which hold the tail without loss
+    node0.process(depth);
+    node1.process(depth);
+    node2.process(depth);
+    node3.process(depth);
+    node4.process(depth);
+    node5.process(depth);
+    node6.process(depth);
+    node7.process(depth);
+    if(shelving){
+      float* results[] = { node0.getResult(), node1.getResult(), node2.getResult(), node3.getResult(),
+			   node4.getResult(), node5.getResult(), node6.getResult(), node7.getResult() };
+      shelves.process(results, steps);
+    }
   }
 };
 
@@ -0,0 +1,78 @@
+#ifndef __TempoLfo_hpp__
+#define __TempoLfo_hpp__
+
+#include "TapTempo.hpp"
+
+/**
+ * Low frequency modulation locked to the beat phase of a TapTempo, with
+ * sine, ramp and square outputs computed from one phase.
+ * Call clock() once per block, after clocking the tempo.
+ */
+class TempoLfo {
+private:
+  float ratio;
+  uint32_t counter;
+  float phase;
+  float previous;
+public:
+  TempoLfo() : ratio(1), counter(1), phase(0), previous(0) {}
+
+  /**
+   * run one cycle per @param r beats, restarting in phase with the tempo
+   * every @param c beats, which must be a whole number of cycles:
+   * for a ratio of 3/2 the counter is 3
+   */
+  void setRatio(float r, uint32_t c){
+    ratio = r;
+    counter = c;
+  }
+
+  template<int TRIGGER_LIMIT>
+  void clock(TapTempo<TRIGGER_LIMIT>& tempo){
+    previous = phase;
+    phase = ((tempo.getBeats() % counter) + tempo.getPhase())/ratio;
+    phase -= (int)phase;
+  }
+
+  /**
+   * get the phase, from 0 to 1
+   */
+  float getRamp(){
+    return phase;
+  }
+
+  /**
+   * get a sine with a range of -1 to 1
+   */
+  float getSine(){
+    return sinf(phase*2*M_PI);
+  }
+
+  /**
+   * get a pulse that is high for the first @param width of every cycle,
+   * for clock outputs
+   */
+  bool getSquare(float width = 0.5f){
+    return phase < width;
+  }
+
+  /**
+   * get the phase at every sample of the last block, for sample rate outputs
+   */
+  void getRamp(FloatArray output){
+    float delta = phase - previous;
+    if(delta < 0)
+      delta += 1; // wrapped
+    output.ramp(previous + delta/output.getSize(), previous + delta + delta/output.getSize());
+    for(size_t i=0; i<output.getSize(); i++)
+      output[i] -= (int)output[i];
+  }
+
+  void getSine(FloatArray output){
+    getRamp(output);
+    for(size_t i=0; i<output.getSize(); i++)
+      output[i] = sinf(output[i]*2*M_PI);
+  }
+};
+
+#endif // __TempoLfo_hpp__